@@ -34,7 +34,8 @@ queue_t* queue_init(int max_count) {
 	q->add_attempts = q->get_attempts = 0;
 	q->add_count = q->get_count = 0;
 
-	err = pthread_create(&q->qmonitor_tid, NULL, qmonitor, q);
+	q->monitor = getenv(QMONITOR_ENV) != NULL;
+	err = q->monitor ? pthread_create(&q->qmonitor_tid, NULL, qmonitor, q) : 0;
 	if (err) {
 		printf("queue_init: pthread_create() failed: %s\n", strerror(err));
 		abort();
@@ -52,8 +53,10 @@ queue_t* queue_init(int max_count) {
 void queue_destroy(queue_t *q) {
     if (q == NULL) return;
     
-    pthread_cancel(q->qmonitor_tid);
-    pthread_join(q->qmonitor_tid, NULL);
+    if (q->monitor) {
+        pthread_cancel(q->qmonitor_tid);
+        pthread_join(q->qmonitor_tid, NULL);
+    }
     
     pthread_spin_destroy(&q->lock);
     
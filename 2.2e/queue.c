@@ -41,7 +41,8 @@ queue_t* queue_init(int max_count) {
         abort();
     }
 
-    err = pthread_create(&q->qmonitor_tid, NULL, qmonitor, q);
+    q->monitor = getenv(QMONITOR_ENV) != NULL;
+    err = q->monitor ? pthread_create(&q->qmonitor_tid, NULL, qmonitor, q) : 0;
     if (err) {
         printf("queue_init: pthread_create() failed: %s\n", strerror(err));
         pthread_mutex_destroy(&q->lock);
@@ -55,8 +56,10 @@ queue_t* queue_init(int max_count) {
 void queue_destroy(queue_t *q) {
     if (q == NULL) return;
     
-    pthread_cancel(q->qmonitor_tid);
-    pthread_join(q->qmonitor_tid, NULL);
+    if (q->monitor) {
+        pthread_cancel(q->qmonitor_tid);
+        pthread_join(q->qmonitor_tid, NULL);
+    }
     
     pthread_mutex_destroy(&q->lock);
     
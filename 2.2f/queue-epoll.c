@@ -0,0 +1,133 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "queue.h"
+
+#define RED "\033[41m"
+#define NOCOLOR "\033[0m"
+
+#define WRITERS 2
+#define BURSTS 200
+#define BURST 1000
+
+// An event loop waits in epoll_wait on a timer (standing in for a socket)
+// and on the queue eventfd at once. Writers add in bursts; every burst
+// should cost about one eventfd write, not one per item.
+
+typedef struct _Writer {
+	queue_t *q;
+	int id;
+} writer_t;
+
+void *writer(void *arg) {
+	writer_t *w = (writer_t *)arg;
+
+	printf("writer %d [%d %d %d]\n", w->id, getpid(), getppid(), gettid());
+
+	for (int b = 0; b < BURSTS; b++) {
+		for (int i = 0; i < BURST; i++)
+			queue_add(w->q, (b * BURST + i) * WRITERS + w->id);
+
+		usleep(1000);
+	}
+
+	return NULL;
+}
+
+static int add_fd(int epfd, int fd) {
+	struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+
+	return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+int main() {
+	struct itimerspec its = { .it_interval = { 0, 100000000 }, .it_value = { 0, 100000000 } };
+	int expected[WRITERS] = { 0 };
+	writer_t writers[WRITERS];
+	pthread_t tids[WRITERS];
+	long got = 0, wakeups = 0, ticks = 0;
+	int qfd, tfd, epfd, err;
+	queue_t *q;
+
+	printf("main [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	q = queue_init(100000);
+
+	qfd = queue_eventfd(q);
+	tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (qfd < 0 || tfd < 0 || epfd < 0) {
+		printf("main: cannot set up fds: %s\n", strerror(errno));
+		return -1;
+	}
+
+	timerfd_settime(tfd, 0, &its, NULL);
+
+	if (add_fd(epfd, qfd) || add_fd(epfd, tfd)) {
+		printf("main: epoll_ctl failed: %s\n", strerror(errno));
+		return -1;
+	}
+
+	for (int i = 0; i < WRITERS; i++) {
+		writers[i].q = q;
+		writers[i].id = i;
+
+		err = pthread_create(&tids[i], NULL, writer, &writers[i]);
+		if (err) {
+			printf("main: pthread_create() failed: %s\n", strerror(err));
+			return -1;
+		}
+	}
+
+	while (got < (long)WRITERS * BURSTS * BURST) {
+		struct epoll_event evs[2];
+		int n = epoll_wait(epfd, evs, 2, -1);
+
+		for (int e = 0; e < n; e++) {
+			if (evs[e].data.fd == tfd) {
+				uint64_t exp;
+
+				if (read(tfd, &exp, sizeof(exp)) > 0)
+					ticks += exp;
+				continue;
+			}
+
+			int vals[64], k;
+
+			wakeups++;
+
+			// drain until empty, that re-arms the eventfd
+			while ((k = queue_try_get_n(q, vals, 64)) > 0) {
+				for (int i = 0; i < k; i++) {
+					int id = vals[i] % WRITERS, seq = vals[i] / WRITERS;
+
+					if (expected[id] != seq)
+						printf(RED"ERROR: writer %d: get seq %d but expected - %d" NOCOLOR "\n", id, seq, expected[id]);
+
+					expected[id] = seq + 1;
+				}
+				got += k;
+			}
+		}
+	}
+
+	for (int i = 0; i < WRITERS; i++)
+		pthread_join(tids[i], NULL);
+
+	printf("got %ld items in %ld queue wakeups, %ld timer ticks\n", got, wakeups, ticks);
+	queue_print_stats(q);
+
+	close(epfd);
+	close(tfd);
+	queue_destroy(q);
+
+	return 0;
+}
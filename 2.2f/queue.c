@@ -1,27 +1,40 @@
 #define _GNU_SOURCE
 #include <pthread.h>
 #include <assert.h>
+#include <sys/eventfd.h>
 
 #include "queue.h"
 
-void *qmonitor(void *arg) {
-	queue_t *q = (queue_t *)arg;
+// Statistics of the calling thread, registered on first use.
+static qstats_t *queue_stats(queue_t *q) {
+    qstats_t *st = pthread_getspecific(q->stats_key);
+    if (st)
+        return st;
 
-	printf("qmonitor: [%d %d %d]\n", getpid(), getppid(), gettid());
+    if (posix_memalign((void **)&st, CACHE_LINE_SIZE, sizeof(qstats_t))) {
+        printf("Cannot allocate memory for queue statistics\n");
+        abort();
+    }
 
-	while (1) {
-		queue_print_stats(q);
-		sleep(1);
-	}
+    st->add_attempts = st->get_attempts = 0;
+    st->add_count = st->get_count = 0;
+
+    pthread_mutex_lock(&q->stats_lock);
+    st->next = q->stats;
+    q->stats = st;
+    pthread_mutex_unlock(&q->stats_lock);
 
-	return NULL;
+    pthread_setspecific(q->stats_key, st);
+
+    return st;
 }
 
 queue_t* queue_init(int max_count) {
     int err;
+    queue_t *q;
 
-    queue_t *q = malloc(sizeof(queue_t));
-    if (!q) {
+    err = posix_memalign((void **)&q, CACHE_LINE_SIZE, sizeof(queue_t));
+    if (err) {
         printf("Cannot allocate memory for a queue\n");
         abort();
     }
@@ -31,12 +44,40 @@ queue_t* queue_init(int max_count) {
     q->max_count = max_count;
     q->count = 0;
 
-    q->add_attempts = q->get_attempts = 0;
-    q->add_count = q->get_count = 0;
+    // Per-thread stats outlive their threads and are freed in
+    // queue_destroy, so the key needs no destructor.
+    q->stats = NULL;
+
+    err = pthread_key_create(&q->stats_key, NULL);
+    if (err) {
+        printf("queue_init: pthread_key_create failed: %s\n", strerror(err));
+        free(q);
+        abort();
+    }
+
+    err = pthread_mutex_init(&q->stats_lock, NULL);
+    if (err) {
+        printf("queue_init: pthread_mutex_init (stats) failed: %s\n", strerror(err));
+        pthread_key_delete(q->stats_key);
+        free(q);
+        abort();
+    }
+
+    err = qpool_init(&q->pool, max_count);
+    if (err) {
+        printf("queue_init: qpool_init failed: %s\n", strerror(err));
+        pthread_mutex_destroy(&q->stats_lock);
+        pthread_key_delete(q->stats_key);
+        free(q);
+        abort();
+    }
 
     err = pthread_mutex_init(&q->lock, NULL);
     if (err) {
         printf("queue_init: pthread_mutex_init failed: %s\n", strerror(err));
+        qpool_destroy(&q->pool);
+        pthread_mutex_destroy(&q->stats_lock);
+        pthread_key_delete(q->stats_key);
         free(q);
         abort();
     }
@@ -45,6 +86,9 @@ queue_t* queue_init(int max_count) {
     if (err) {
         printf("queue_init: pthread_cond_init (not_empty) failed: %s\n", strerror(err));
         pthread_mutex_destroy(&q->lock);
+        qpool_destroy(&q->pool);
+        pthread_mutex_destroy(&q->stats_lock);
+        pthread_key_delete(q->stats_key);
         free(q);
         abort();
     }
@@ -54,66 +98,220 @@ queue_t* queue_init(int max_count) {
         printf("queue_init: pthread_cond_init (not_full) failed: %s\n", strerror(err));
         pthread_mutex_destroy(&q->lock);
         pthread_cond_destroy(&q->not_empty);
+        qpool_destroy(&q->pool);
+        pthread_mutex_destroy(&q->stats_lock);
+        pthread_key_delete(q->stats_key);
         free(q);
         abort();
     }
 
-    err = pthread_create(&q->qmonitor_tid, NULL, qmonitor, q);
-    if (err) {
-        printf("queue_init: pthread_create() failed: %s\n", strerror(err));
-        pthread_mutex_destroy(&q->lock);
-        free(q);
-        abort();
-    }
+    q->spill = NULL;
+
+    q->efd = -1;
+    q->signalled = 0;
+    q->efd_writes = 0;
+
+    q->tm = NULL;
+    if (getenv(QTM_ENV))
+        q->tm = qtm_open(getenv(QTM_ENV), max_count);
+
+    q->trace = qtrace_open();
 
     return q;
 }
 
 void queue_destroy(queue_t *q) {
     if (q == NULL) return;
-    
-    pthread_cancel(q->qmonitor_tid);
-    pthread_join(q->qmonitor_tid, NULL);
-    
+
+    qtm_close(q->tm);
+    qtrace_close(q->trace);
+
+    if (q->spill) {
+        qspill_destroy(q->spill);
+        free(q->spill);
+    }
+
+    if (q->efd >= 0)
+        close(q->efd);
+
     pthread_mutex_destroy(&q->lock);
     pthread_cond_destroy(&q->not_empty);
     pthread_cond_destroy(&q->not_full);
-    
-    qnode_t *current = q->first;
-    while (current != NULL) {
-        qnode_t *temp = current;
-        current = current->next;
-        free(temp);
+
+    // queued nodes live in the pool chunks and go away with them
+    qpool_destroy(&q->pool);
+
+    pthread_key_delete(q->stats_key);
+    pthread_mutex_destroy(&q->stats_lock);
+    while (q->stats) {
+        qstats_t *st = q->stats;
+        q->stats = st->next;
+        free(st);
     }
-    
+
     free(q);
 }
 
-int queue_add(queue_t *q, int val) {
+int queue_set_spill(queue_t *q, const char *dir, int seg_items) {
+    qspill_t *spill = malloc(sizeof(qspill_t));
+    int err;
+
+    if (!spill)
+        return ENOMEM;
+
+    err = qspill_init(spill, dir, seg_items ? seg_items : QSPILL_SEGMENT_ITEMS);
+    if (err) {
+        free(spill);
+        return err;
+    }
+
     pthread_mutex_lock(&q->lock);
+    q->spill = spill;
+    pthread_mutex_unlock(&q->lock);
 
-    while (q->count == q->max_count) {
+    return 0;
+}
+
+// Items on disk; they are all newer than the ones in memory.
+static inline long queue_spilled(queue_t *q) {
+    return q->spill ? q->spill->count : 0;
+}
+
+// In overflow mode an add that would block goes to disk instead, and so
+// does every add while older items are still there. If the disk is full
+// the add blocks as it would without overflow mode.
+static inline int queue_must_spill(queue_t *q) {
+    return q->spill && (q->spill->count || q->count == q->max_count);
+}
+
+int queue_eventfd(queue_t *q) {
+    int fd;
+
+    pthread_mutex_lock(&q->lock);
+
+    if (q->efd < 0) {
+        fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fd < 0) {
+            pthread_mutex_unlock(&q->lock);
+            return -1;
+        }
+
+        q->efd = fd;
+
+        // items added before there was an fd
+        if (q->count || queue_spilled(q)) {
+            q->signalled = 1;
+            q->efd_writes++;
+            eventfd_write(q->efd, 1);
+        }
+    }
+
+    fd = q->efd;
+    pthread_mutex_unlock(&q->lock);
+
+    return fd;
+}
+
+// Called with the lock held after an add. Returns 1 if the caller has to
+// write the eventfd once it dropped the lock.
+static inline int queue_arm_event(queue_t *q) {
+    if (q->efd < 0 || q->signalled)
+        return 0;
+
+    q->signalled = 1;
+    q->efd_writes++;
+    return 1;
+}
+
+// Called with the lock held by a get that found the queue empty. An add
+// that comes later sees signalled clear and writes again, so no wakeup is
+// lost. The counter is drained even when signalled is already clear: the
+// add that set it writes after dropping the lock, so its write can land
+// after an earlier disarm and must not leave the fd readable for good.
+// The fd is non-blocking, an empty counter just fails the read.
+static inline void queue_disarm_event(queue_t *q) {
+    eventfd_t cnt;
+
+    if (q->efd < 0)
+        return;
+
+    q->signalled = 0;
+    eventfd_read(q->efd, &cnt);
+}
+
+// Blocks until the queue is not full. Also waits for the spill to drain:
+// an item put in memory before that would overtake the ones on disk.
+// Returns how long that took when telemetry is on, 0 otherwise.
+static uint64_t queue_wait_not_full(queue_t *q) {
+    uint64_t start;
+
+    if (q->count < q->max_count && !queue_spilled(q))
+        return 0;
+
+    start = q->tm ? qtm_now() : 0;
+    while (q->count == q->max_count || queue_spilled(q)) {
         pthread_cond_wait(&q->not_full, &q->lock);
     }
+
+    return q->tm ? qtm_now() - start : 0;
+}
+
+static uint64_t queue_wait_not_empty(queue_t *q) {
+    uint64_t start;
+
+    if (q->count > 0 || queue_spilled(q))
+        return 0;
+
+    start = q->tm ? qtm_now() : 0;
+    while (q->count == 0 && !queue_spilled(q)) {
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    }
+
+    return q->tm ? qtm_now() - start : 0;
+}
+
+int queue_add(queue_t *q, int val) {
+    qstats_t *st = queue_stats(q);
+    qnode_t *new = qpool_alloc(&q->pool);
+    uint64_t wait;
+    int depth, notify;
+
+    new->val = val;
+    new->next = NULL;
+
+    pthread_mutex_lock(&q->lock);
+
+    if (queue_must_spill(q) && qspill_push_n(q->spill, &q->lock, &val, 1)) {
+        st->add_attempts++;
+        st->add_count++;
+        notify = queue_arm_event(q);
+
+        pthread_cond_signal(&q->not_empty);
+        pthread_mutex_unlock(&q->lock);
+
+        if (notify)
+            eventfd_write(q->efd, 1);
+
+        qpool_free(&q->pool, new);
+        return 1;
+    }
+
+    wait = queue_wait_not_full(q);
     
-    q->add_attempts++;
+    st->add_attempts++;
     
     assert(q->count <= q->max_count);
     
     if (q->count == q->max_count) {
         pthread_mutex_unlock(&q->lock);
+        qpool_free(&q->pool, new);
         return 0;
     }
-    
-    qnode_t *new = malloc(sizeof(qnode_t));
-    if (!new) {
-        printf("Cannot allocate memory for new node\n");
-        pthread_mutex_unlock(&q->lock);
-        abort();
-    }
-    
-    new->val = val;
-    new->next = NULL;
+
+    // stamped only now: time blocked on a full queue is add wait, not
+    // residency
+    if (q->trace)
+        QTRACE_STAMP(new, qtm_now());
     
     if (!q->first)
         q->first = q->last = new;
@@ -123,23 +321,47 @@ int queue_add(queue_t *q, int val) {
     }
     
     q->count++;
-    q->add_count++;
+    st->add_count++;
+    depth = q->count;
+    notify = queue_arm_event(q);
     
     pthread_cond_signal(&q->not_empty);
     pthread_mutex_unlock(&q->lock);
+
+    if (notify)
+        eventfd_write(q->efd, 1);
+
+    if (q->tm)
+        qtm_on_add(q->tm, wait, depth);
     return 1;
 }
 
 int queue_get(queue_t *q, int *val) {
+    qstats_t *st = queue_stats(q);
+    uint64_t wait;
+    int depth;
+
     pthread_mutex_lock(&q->lock);
 
-    while (q->count == 0) {
-        pthread_cond_wait(&q->not_empty, &q->lock);
-    }
+    wait = queue_wait_not_empty(q);
     
-    q->get_attempts++;
+    st->get_attempts++;
     
     assert(q->count >= 0);
+
+    if (q->count == 0 && queue_spilled(q)) {
+        qspill_pop(q->spill, val);
+        st->get_count++;
+
+        // adds that found the disk full wait for this
+        if (!queue_spilled(q))
+            pthread_cond_broadcast(&q->not_full);
+        pthread_mutex_unlock(&q->lock);
+
+        if (q->tm)
+            qtm_on_get(q->tm, wait, 0);
+        return 1;
+    }
     
     if (q->count == 0) {
         pthread_mutex_unlock(&q->lock);
@@ -150,19 +372,251 @@ int queue_get(queue_t *q, int *val) {
     *val = tmp->val;
     q->first = q->first->next;
     
-    free(tmp);
     q->count--;
-    q->get_count++;
+    st->get_count++;
+    depth = q->count;
     
     pthread_cond_signal(&q->not_full);
     pthread_mutex_unlock(&q->lock);
+
+    if (q->trace)
+        QTRACE_RECORD(q->trace, tmp, qtm_now());
+
+    qpool_free(&q->pool, tmp);
+
+    if (q->tm)
+        qtm_on_get(q->tm, wait, depth);
     return 1;
 }
 
+static void queue_free_nodes(queue_t *q, qnode_t *node) {
+    while (node) {
+        qnode_t *tmp = node;
+        node = node->next;
+        qpool_free(&q->pool, tmp);
+    }
+}
+
+// Waits for one free slot, then adds as many of vals as fit. Nodes that did
+// not fit go back to the pool; the caller retries with the rest. In
+// overflow mode the rest is spilled and all n are added, unless the disk
+// fills up on the way.
+int queue_add_n(queue_t *q, const int *vals, int n) {
+    qstats_t *st = queue_stats(q);
+    qnode_t *first = NULL, *last = NULL;
+    uint64_t wait, stamp;
+    int k, depth, notify;
+
+    if (n <= 0)
+        return 0;
+
+    for (int i = 0; i < n; i++) {
+        qnode_t *new = qpool_alloc(&q->pool);
+
+        new->val = vals[i];
+        new->next = NULL;
+
+        if (!first)
+            first = last = new;
+        else {
+            last->next = new;
+            last = new;
+        }
+    }
+
+    pthread_mutex_lock(&q->lock);
+
+    if (queue_must_spill(q) && (k = qspill_push_n(q->spill, &q->lock, vals, n))) {
+        st->add_attempts++;
+        st->add_count += k;
+        notify = queue_arm_event(q);
+
+        pthread_cond_broadcast(&q->not_empty);
+        pthread_mutex_unlock(&q->lock);
+
+        if (notify)
+            eventfd_write(q->efd, 1);
+
+        queue_free_nodes(q, first);
+        return k;
+    }
+
+    wait = queue_wait_not_full(q);
+
+    st->add_attempts++;
+
+    k = q->max_count - q->count;
+    if (k > n)
+        k = n;
+
+    // stamp the linked nodes after the wait, as queue_add does
+    stamp = q->trace ? qtm_now() : 0;
+
+    qnode_t *tail = first;
+    QTRACE_STAMP(tail, stamp);
+    for (int i = 1; i < k; i++) {
+        tail = tail->next;
+        QTRACE_STAMP(tail, stamp);
+    }
+    qnode_t *rest = tail->next;
+    tail->next = NULL;
+
+    if (!q->first)
+        q->first = first;
+    else
+        q->last->next = first;
+    q->last = tail;
+
+    q->count += k;
+    st->add_count += k;
+    depth = q->count;
+
+    // in overflow mode what did not fit goes to disk, as far as it fits
+    if (q->spill && k < n) {
+        int done = qspill_push_n(q->spill, &q->lock, vals + k, n - k);
+
+        st->add_count += done;
+        k += done;
+    }
+
+    notify = queue_arm_event(q);
+
+    // one wakeup per batch: a single item is enough for one reader only
+    if (k > 1)
+        pthread_cond_broadcast(&q->not_empty);
+    else
+        pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+
+    if (notify)
+        eventfd_write(q->efd, 1);
+
+    queue_free_nodes(q, rest);
+
+    if (q->tm)
+        qtm_on_add(q->tm, wait, depth);
+    return k;
+}
+
+// queue_get_n and queue_try_get_n. Returns how many items were taken.
+static int queue_take_n(queue_t *q, int *out, int max, int block) {
+    qstats_t *st = queue_stats(q);
+    qnode_t *first, *last;
+    uint64_t wait = 0, now;
+    int k, depth;
+
+    if (max <= 0)
+        return 0;
+
+    pthread_mutex_lock(&q->lock);
+
+    if (block)
+        wait = queue_wait_not_empty(q);
+
+    st->get_attempts++;
+
+    if (q->count == 0 && !queue_spilled(q)) {
+        queue_disarm_event(q);
+        pthread_mutex_unlock(&q->lock);
+        return 0;
+    }
+
+    if (q->count == 0 && queue_spilled(q)) {
+        for (k = 0; k < max && qspill_pop(q->spill, &out[k]); k++)
+            ;
+        st->get_count += k;
+
+        if (!queue_spilled(q))
+            pthread_cond_broadcast(&q->not_full);
+        pthread_mutex_unlock(&q->lock);
+
+        if (q->tm)
+            qtm_on_get(q->tm, wait, 0);
+
+        return k;
+    }
+
+    k = q->count < max ? q->count : max;
+
+    first = last = q->first;
+    for (int i = 1; i < k; i++)
+        last = last->next;
+    q->first = last->next;
+
+    q->count -= k;
+    st->get_count += k;
+    depth = q->count;
+
+    if (k > 1)
+        pthread_cond_broadcast(&q->not_full);
+    else
+        pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+
+    now = q->trace ? qtm_now() : 0;
+
+    for (int i = 0; i < k; i++) {
+        qnode_t *tmp = first;
+
+        out[i] = tmp->val;
+        first = first->next;
+        if (q->trace)
+            QTRACE_RECORD(q->trace, tmp, now);
+        qpool_free(&q->pool, tmp);
+    }
+
+    if (q->tm)
+        qtm_on_get(q->tm, wait, depth);
+
+    return k;
+}
+
+int queue_get_n(queue_t *q, int *out, int max, int *got) {
+    *got = queue_take_n(q, out, max, 1);
+    return max > 0;
+}
+
+int queue_try_get_n(queue_t *q, int *out, int max) {
+    return queue_take_n(q, out, max, 0);
+}
+
+int queue_try_get(queue_t *q, int *val) {
+    return queue_take_n(q, val, 1, 0);
+}
+
+void queue_get_stats(queue_t *q, qstats_t *sum) {
+	sum->add_attempts = sum->get_attempts = 0;
+	sum->add_count = sum->get_count = 0;
+
+	pthread_mutex_lock(&q->stats_lock);
+	for (qstats_t *st = q->stats; st; st = st->next) {
+		sum->add_attempts += st->add_attempts;
+		sum->get_attempts += st->get_attempts;
+		sum->add_count += st->add_count;
+		sum->get_count += st->get_count;
+	}
+	pthread_mutex_unlock(&q->stats_lock);
+}
+
 void queue_print_stats(queue_t *q) {
+	qstats_t sum;
+
+	queue_get_stats(q, &sum);
+
 	printf("queue stats: current size %d; attempts: (%ld %ld %ld); counts (%ld %ld %ld)\n",
 		q->count,
-		q->add_attempts, q->get_attempts, q->add_attempts - q->get_attempts,
-		q->add_count, q->get_count, q->add_count -q->get_count);
-}
+		sum.add_attempts, sum.get_attempts, sum.add_attempts - sum.get_attempts,
+		sum.add_count, sum.get_count, sum.add_count - sum.get_count);
 
+	if (q->efd >= 0)
+		printf("eventfd stats: writes %ld for %ld adds\n",
+			__atomic_load_n(&q->efd_writes, __ATOMIC_RELAXED), sum.add_count);
+
+	if (q->spill) {
+		pthread_mutex_lock(&q->lock);
+		printf("spill stats: on disk %ld; spilled %ld; replayed %ld; segments %ld; recycled %ld; failed %ld\n",
+			q->spill->count, q->spill->spilled, q->spill->replayed,
+			q->spill->segments, q->spill->recycled, q->spill->failed);
+		pthread_mutex_unlock(&q->lock);
+	}
+}
@@ -9,34 +9,104 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "qpool.h"
+#include "qtelemetry.h"
+#include "qspill.h"
+#include "qtrace.h"
+
 typedef struct _QueueNode {
 	int val;
 	struct _QueueNode *next;
+#if QTRACE
+	uint64_t stamp;		// when it was added
+#endif
 } qnode_t;
 
-typedef struct _Queue {
-	qnode_t *first;
-	qnode_t *last;
-
-	pthread_t qmonitor_tid;
-
-	int count;
-	int max_count;
+#define CACHE_LINE_SIZE 64
 
-	// queue statistics
+// Statistics of one thread. Each thread that uses the queue gets its own
+// cache line, so counting never bounces lines between producers and
+// consumers. queue_print_stats sums them up.
+typedef struct _QueueStats {
 	long add_attempts;
 	long get_attempts;
 	long add_count;
 	long get_count;
-	pthread_mutex_t lock;
+	struct _QueueStats *next;
+} __attribute__((aligned(CACHE_LINE_SIZE))) qstats_t;
+
+typedef struct _Queue {
+	// consumer side: list head and the condvar readers sleep on
+	qnode_t *first __attribute__((aligned(CACHE_LINE_SIZE)));
 	pthread_cond_t not_empty;
-    pthread_cond_t not_full;
+
+	// producer side: list tail and the condvar writers sleep on
+	qnode_t *last __attribute__((aligned(CACHE_LINE_SIZE)));
+	pthread_cond_t not_full;
+
+	// shared by both sides
+	pthread_mutex_t lock __attribute__((aligned(CACHE_LINE_SIZE)));
+	int count;
+	int max_count;
+
+	// eventfd mode, efd is -1 until queue_eventfd. signalled is set by the
+	// add that writes the eventfd and cleared when a non-blocking get finds
+	// the queue empty, so a burst of adds costs one write.
+	int efd;
+	int signalled;
+	long efd_writes;
+
+	// cold: statistics registry
+	pthread_key_t stats_key __attribute__((aligned(CACHE_LINE_SIZE)));
+	pthread_mutex_t stats_lock;
+	qstats_t *stats;
+
+	// histograms published to the QUEUE_TELEMETRY file, NULL when disabled
+	qtm_t *tm;
+
+	// overflow on disk, NULL unless queue_set_spill was called
+	qspill_t *spill;
+
+	// time in queue histogram, NULL unless built with QTRACE=1 and
+	// QUEUE_TRACE is set. Spilled items carry no stamp and are not traced.
+	qtrace_t *trace;
+
+	// nodes are taken from and returned to the pool outside of lock
+	qpool_t pool;
 } queue_t;
 
 queue_t* queue_init(int max_count);
 void queue_destroy(queue_t *q);
 int queue_add(queue_t *q, int val);
 int queue_get(queue_t *q, int *val);
+
+// Batched versions: block until at least one item fits (is available), then
+// move as many as possible under a single lock acquisition.
+// queue_add_n returns how many of vals were added; queue_get_n stores the
+// number of items copied to out in *got.
+int queue_add_n(queue_t *q, const int *vals, int n);
+int queue_get_n(queue_t *q, int *out, int max, int *got);
+
+// Non-blocking gets for event loops: 0 if the queue is empty. Finding it
+// empty also re-arms the eventfd.
+int queue_try_get(queue_t *q, int *val);
+int queue_try_get_n(queue_t *q, int *out, int max);
+
+// Returns an eventfd that polls readable while items may be available, or
+// -1 with errno set. After it fires, take items with queue_try_get(_n)
+// until they return 0; the fd only becomes readable again once that
+// happened and something new was added. Wakeups can be spurious.
+int queue_eventfd(queue_t *q);
+
+// Overflow mode: once max_count items are in memory, queue_add stops
+// blocking and appends to segment files in dir (seg_items ints each, 0 for
+// the default) instead. While anything is on disk new items go there too,
+// and queue_get replays them after the in-memory ones, so the order stays
+// FIFO. Must be called before the queue is used. Returns 0 or an errno.
+int queue_set_spill(queue_t *q, const char *dir, int seg_items);
+
+// Sum of the per-thread statistics at the moment of the call.
+void queue_get_stats(queue_t *q, qstats_t *sum);
 void queue_print_stats(queue_t *q);
 
 #endif		// __FITOS_QUEUE_H__
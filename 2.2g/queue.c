@@ -5,24 +5,36 @@
 
 #include "queue.h"
 
-void *qmonitor(void *arg) {
-	queue_t *q = (queue_t *)arg;
+// Statistics of the calling thread, registered on first use.
+static qstats_t *queue_stats(queue_t *q) {
+    qstats_t *st = pthread_getspecific(q->stats_key);
+    if (st)
+        return st;
 
-	printf("qmonitor: [%d %d %d]\n", getpid(), getppid(), gettid());
+    if (posix_memalign((void **)&st, CACHE_LINE_SIZE, sizeof(qstats_t))) {
+        printf("Cannot allocate memory for queue statistics\n");
+        abort();
+    }
 
-	while (1) {
-		queue_print_stats(q);
-		sleep(1);
-	}
+    st->add_attempts = st->get_attempts = 0;
+    st->add_count = st->get_count = 0;
 
-	return NULL;
+    pthread_mutex_lock(&q->stats_lock);
+    st->next = q->stats;
+    q->stats = st;
+    pthread_mutex_unlock(&q->stats_lock);
+
+    pthread_setspecific(q->stats_key, st);
+
+    return st;
 }
 
 queue_t* queue_init(int max_count) {
     int err;
+    queue_t *q;
 
-    queue_t *q = malloc(sizeof(queue_t));
-    if (!q) {
+    err = posix_memalign((void **)&q, CACHE_LINE_SIZE, sizeof(queue_t));
+    if (err) {
         printf("Cannot allocate memory for a queue\n");
         abort();
     }
@@ -32,12 +44,40 @@ queue_t* queue_init(int max_count) {
     q->max_count = max_count;
     q->count = 0;
 
-    q->add_attempts = q->get_attempts = 0;
-    q->add_count = q->get_count = 0;
+    // Per-thread stats outlive their threads and are freed in
+    // queue_destroy, so the key needs no destructor.
+    q->stats = NULL;
+
+    err = pthread_key_create(&q->stats_key, NULL);
+    if (err) {
+        printf("queue_init: pthread_key_create failed: %s\n", strerror(err));
+        free(q);
+        abort();
+    }
+
+    err = pthread_mutex_init(&q->stats_lock, NULL);
+    if (err) {
+        printf("queue_init: pthread_mutex_init (stats) failed: %s\n", strerror(err));
+        pthread_key_delete(q->stats_key);
+        free(q);
+        abort();
+    }
+
+    err = qpool_init(&q->pool, max_count);
+    if (err) {
+        printf("queue_init: qpool_init failed: %s\n", strerror(err));
+        pthread_mutex_destroy(&q->stats_lock);
+        pthread_key_delete(q->stats_key);
+        free(q);
+        abort();
+    }
 
     err = sem_init(&q->empty, 0, max_count);
     if (err) {
         printf("queue_init: sem_init (empty) failed\n");
+        qpool_destroy(&q->pool);
+        pthread_mutex_destroy(&q->stats_lock);
+        pthread_key_delete(q->stats_key);
         free(q);
         abort();
     }
@@ -46,6 +86,9 @@ queue_t* queue_init(int max_count) {
     if (err) {
         printf("queue_init: sem_init (full) failed\n");
         sem_destroy(&q->empty);
+        qpool_destroy(&q->pool);
+        pthread_mutex_destroy(&q->stats_lock);
+        pthread_key_delete(q->stats_key);
         free(q);
         abort();
     }
@@ -55,67 +98,246 @@ queue_t* queue_init(int max_count) {
         printf("queue_init: pthread_mutex_init failed: %s\n", strerror(err));
         sem_destroy(&q->empty);
         sem_destroy(&q->full);
+        qpool_destroy(&q->pool);
+        pthread_mutex_destroy(&q->stats_lock);
+        pthread_key_delete(q->stats_key);
         free(q);
         abort();
     }
 
-    err = pthread_create(&q->qmonitor_tid, NULL, qmonitor, q);
+    err = pthread_cond_init(&q->drained, NULL);
     if (err) {
-        printf("queue_init: pthread_create() failed: %s\n", strerror(err));
+        printf("queue_init: pthread_cond_init failed: %s\n", strerror(err));
+        pthread_mutex_destroy(&q->lock);
         sem_destroy(&q->empty);
         sem_destroy(&q->full);
-        pthread_mutex_destroy(&q->lock);
+        qpool_destroy(&q->pool);
+        pthread_mutex_destroy(&q->stats_lock);
+        pthread_key_delete(q->stats_key);
         free(q);
         abort();
     }
 
+    q->spill = NULL;
+
+    q->tm = NULL;
+    if (getenv(QTM_ENV))
+        q->tm = qtm_open(getenv(QTM_ENV), max_count);
+
+    q->trace = qtrace_open();
+
     return q;
 }
 
 void queue_destroy(queue_t *q) {
     if (q == NULL) return;
-    
-    pthread_cancel(q->qmonitor_tid);
-    pthread_join(q->qmonitor_tid, NULL);
-    
+
+    qtm_close(q->tm);
+    qtrace_close(q->trace);
+
+    if (q->spill) {
+        qspill_destroy(q->spill);
+        free(q->spill);
+    }
+
     sem_destroy(&q->empty);
     sem_destroy(&q->full);
+    pthread_cond_destroy(&q->drained);
     pthread_mutex_destroy(&q->lock);
-    
-    qnode_t *current = q->first;
-    while (current != NULL) {
-        qnode_t *temp = current;
-        current = current->next;
-        free(temp);
+
+    // queued nodes live in the pool chunks and go away with them
+    qpool_destroy(&q->pool);
+
+    pthread_key_delete(q->stats_key);
+    pthread_mutex_destroy(&q->stats_lock);
+    while (q->stats) {
+        qstats_t *st = q->stats;
+        q->stats = st->next;
+        free(st);
     }
-    
+
     free(q);
 }
 
+int queue_set_spill(queue_t *q, const char *dir, int seg_items) {
+    qspill_t *spill = malloc(sizeof(qspill_t));
+    int err;
+
+    if (!spill)
+        return ENOMEM;
+
+    err = qspill_init(spill, dir, seg_items ? seg_items : QSPILL_SEGMENT_ITEMS);
+    if (err) {
+        free(spill);
+        return err;
+    }
+
+    pthread_mutex_lock(&q->lock);
+    q->spill = spill;
+    pthread_mutex_unlock(&q->lock);
+
+    return 0;
+}
+
+// Items on disk; they are all newer than the ones in memory.
+static inline long queue_spilled(queue_t *q) {
+    return q->spill ? q->spill->count : 0;
+}
+
+static void queue_free_nodes(queue_t *q, qnode_t *node) {
+    while (node) {
+        qnode_t *tmp = node;
+        node = node->next;
+        qpool_free(&q->pool, tmp);
+    }
+}
+
+// Overflow mode add, called with the lock held; returns with it released
+// and full posted once per item. Takes a memory slot only if one is free
+// right now and nothing is on disk; otherwise the items are spilled. The
+// lock orders adds, so the check and the slot cannot go stale in between.
+// If the disk is full, the rest waits for the spill to drain and for
+// memory slots, as a queue without overflow mode would. Returns the depth
+// after the add; nodes not used are left in *rest for the caller to free.
+static int queue_add_spill(queue_t *q, qnode_t *first, const int *vals, int n,
+                           qnode_t **rest) {
+    qnode_t *last = NULL, *node;
+    int k = 0, done, depth;
+
+    while (k < n && !q->spill->count && sem_trywait(&q->empty) == 0) {
+        last = last ? last->next : first;
+        k++;
+    }
+
+    *rest = first;
+    if (k) {
+        *rest = last->next;
+        last->next = NULL;
+
+        if (!q->first)
+            q->first = first;
+        else
+            q->last->next = first;
+        q->last = last;
+        q->count += k;
+    }
+
+    done = k + qspill_push_n(q->spill, &q->lock, vals + k, n - k);
+    depth = q->count;
+
+    pthread_mutex_unlock(&q->lock);
+
+    for (int i = 0; i < done; i++)
+        sem_post(&q->full);
+
+    if (done == n)
+        return depth;
+
+    // split off the nodes of the items that did make it to disk
+    last = NULL;
+    node = *rest;
+    for (int i = k; i < done; i++) {
+        last = node;
+        node = node->next;
+    }
+    if (last)
+        last->next = NULL;
+    else
+        *rest = NULL;
+
+    while (node) {
+        qnode_t *new = node;
+
+        node = node->next;
+        new->next = NULL;
+
+        sem_wait(&q->empty);
+        pthread_mutex_lock(&q->lock);
+
+        while (q->spill->count)
+            pthread_cond_wait(&q->drained, &q->lock);
+
+        if (q->trace)
+            QTRACE_STAMP(new, qtm_now());
+
+        if (!q->first)
+            q->first = new;
+        else
+            q->last->next = new;
+        q->last = new;
+        q->count++;
+        depth = q->count;
+
+        pthread_mutex_unlock(&q->lock);
+        sem_post(&q->full);
+    }
+
+    return depth;
+}
+
+// sem_wait that reports how long it blocked when telemetry is on.
+// The timed path only runs once sem_trywait has failed.
+static uint64_t queue_sem_wait(queue_t *q, sem_t *sem) {
+    uint64_t start;
+
+    if (!q->tm) {
+        sem_wait(sem);
+        return 0;
+    }
+
+    if (sem_trywait(sem) == 0)
+        return 0;
+
+    start = qtm_now();
+    sem_wait(sem);
+    return qtm_now() - start;
+}
+
 int queue_add(queue_t *q, int val) {
-    sem_wait(&q->empty);
+    qstats_t *st = queue_stats(q);
+    qnode_t *new = qpool_alloc(&q->pool);
+    qnode_t *rest;
+    uint64_t wait;
+    int depth;
+
+    new->val = val;
+    new->next = NULL;
+
+    if (q->spill) {
+        pthread_mutex_lock(&q->lock);
+
+        if (q->trace)
+            QTRACE_STAMP(new, qtm_now());
+
+        st->add_attempts++;
+        st->add_count++;
+        depth = queue_add_spill(q, new, &val, 1, &rest);
+
+        queue_free_nodes(q, rest);
+
+        if (q->tm)
+            qtm_on_add(q->tm, 0, depth);
+        return 1;
+    }
+
+    wait = queue_sem_wait(q, &q->empty);
 
     pthread_mutex_lock(&q->lock);
     
-    q->add_attempts++;
+    st->add_attempts++;
     
     assert(q->count <= q->max_count);
     
     if (q->count == q->max_count) {
         pthread_mutex_unlock(&q->lock);
+        qpool_free(&q->pool, new);
         return 0;
     }
-    
-    qnode_t *new = malloc(sizeof(qnode_t));
-    if (!new) {
-        printf("Cannot allocate memory for new node\n");
-        pthread_mutex_unlock(&q->lock);
-        sem_post(&q->empty);
-        abort();
-    }
-    
-    new->val = val;
-    new->next = NULL;
+
+    // stamped only now: time blocked on a full queue is add wait, not
+    // residency
+    if (q->trace)
+        QTRACE_STAMP(new, qtm_now());
     
     if (!q->first)
         q->first = q->last = new;
@@ -125,21 +347,44 @@ int queue_add(queue_t *q, int val) {
     }
     
     q->count++;
-    q->add_count++;
+    st->add_count++;
+    depth = q->count;
     
     pthread_mutex_unlock(&q->lock);
     sem_post(&q->full);
+
+    if (q->tm)
+        qtm_on_add(q->tm, wait, depth);
     return 1;
 }
 
 int queue_get(queue_t *q, int *val) {
-    sem_wait(&q->full);
+    qstats_t *st = queue_stats(q);
+    uint64_t wait;
+    int depth;
+
+    wait = queue_sem_wait(q, &q->full);
 
     pthread_mutex_lock(&q->lock);
     
-    q->get_attempts++;
+    st->get_attempts++;
     
     assert(q->count >= 0);
+
+    // full counted a spilled item; no memory slot is freed
+    if (q->count == 0 && queue_spilled(q)) {
+        qspill_pop(q->spill, val);
+        st->get_count++;
+
+        // adds that found the disk full wait for this
+        if (!queue_spilled(q))
+            pthread_cond_broadcast(&q->drained);
+        pthread_mutex_unlock(&q->lock);
+
+        if (q->tm)
+            qtm_on_get(q->tm, wait, 0);
+        return 1;
+    }
     
     if (q->count == 0) {
         pthread_mutex_unlock(&q->lock);
@@ -150,19 +395,208 @@ int queue_get(queue_t *q, int *val) {
     *val = tmp->val;
     q->first = q->first->next;
     
-    free(tmp);
     q->count--;
-    q->get_count++;
+    st->get_count++;
+    depth = q->count;
     
     pthread_mutex_unlock(&q->lock);
     sem_post(&q->empty);
+
+    if (q->trace)
+        QTRACE_RECORD(q->trace, tmp, qtm_now());
+
+    qpool_free(&q->pool, tmp);
+
+    if (q->tm)
+        qtm_on_get(q->tm, wait, depth);
     return 1;
 }
 
+// Takes one slot blocking and as many more as are free right now, so a
+// full queue still makes progress one item at a time. sem_post only enters
+// the kernel when somebody sleeps on the semaphore, so posting k times is
+// cheap compared to k separate lock round trips.
+int queue_add_n(queue_t *q, const int *vals, int n) {
+    qstats_t *st = queue_stats(q);
+    qnode_t *first = NULL, *last = NULL;
+    uint64_t wait, stamp;
+    int k = 1, depth;
+
+    if (n <= 0)
+        return 0;
+
+    if (q->spill) {
+        stamp = q->trace ? qtm_now() : 0;
+
+        for (int i = 0; i < n; i++) {
+            qnode_t *new = qpool_alloc(&q->pool);
+
+            new->val = vals[i];
+            new->next = NULL;
+            QTRACE_STAMP(new, stamp);
+
+            if (!first)
+                first = last = new;
+            else {
+                last->next = new;
+                last = new;
+            }
+        }
+
+        pthread_mutex_lock(&q->lock);
+
+        st->add_attempts++;
+        st->add_count += n;
+        depth = queue_add_spill(q, first, vals, n, &first);
+
+        queue_free_nodes(q, first);
+
+        if (q->tm)
+            qtm_on_add(q->tm, 0, depth);
+        return n;
+    }
+
+    wait = queue_sem_wait(q, &q->empty);
+    while (k < n && sem_trywait(&q->empty) == 0)
+        k++;
+
+    // stamp after the wait, as queue_add does
+    stamp = q->trace ? qtm_now() : 0;
+
+    for (int i = 0; i < k; i++) {
+        qnode_t *new = qpool_alloc(&q->pool);
+
+        new->val = vals[i];
+        new->next = NULL;
+        QTRACE_STAMP(new, stamp);
+
+        if (!first)
+            first = last = new;
+        else {
+            last->next = new;
+            last = new;
+        }
+    }
+
+    pthread_mutex_lock(&q->lock);
+
+    st->add_attempts++;
+
+    assert(q->count + k <= q->max_count);
+
+    if (!q->first)
+        q->first = first;
+    else
+        q->last->next = first;
+    q->last = last;
+
+    q->count += k;
+    st->add_count += k;
+    depth = q->count;
+
+    pthread_mutex_unlock(&q->lock);
+
+    for (int i = 0; i < k; i++)
+        sem_post(&q->full);
+
+    if (q->tm)
+        qtm_on_add(q->tm, wait, depth);
+    return k;
+}
+
+int queue_get_n(queue_t *q, int *out, int max, int *got) {
+    qstats_t *st = queue_stats(q);
+    qnode_t *first = NULL, *last;
+    uint64_t wait, now;
+    int k = 1, m, depth;
+
+    *got = 0;
+    if (max <= 0)
+        return 0;
+
+    wait = queue_sem_wait(q, &q->full);
+    while (k < max && sem_trywait(&q->full) == 0)
+        k++;
+
+    pthread_mutex_lock(&q->lock);
+
+    st->get_attempts++;
+
+    assert(q->count + queue_spilled(q) >= k);
+
+    // memory holds the oldest items; the rest of the k comes from disk
+    m = q->count < k ? q->count : k;
+
+    if (m) {
+        first = last = q->first;
+        for (int i = 1; i < m; i++)
+            last = last->next;
+        q->first = last->next;
+    }
+
+    for (int i = m; i < k; i++)
+        qspill_pop(q->spill, &out[i]);
+
+    if (m < k && !queue_spilled(q))
+        pthread_cond_broadcast(&q->drained);
+
+    q->count -= m;
+    st->get_count += k;
+    depth = q->count;
+
+    pthread_mutex_unlock(&q->lock);
+
+    for (int i = 0; i < m; i++)
+        sem_post(&q->empty);
+
+    now = q->trace ? qtm_now() : 0;
+
+    for (int i = 0; i < m; i++) {
+        qnode_t *tmp = first;
+
+        out[i] = tmp->val;
+        first = first->next;
+        if (q->trace)
+            QTRACE_RECORD(q->trace, tmp, now);
+        qpool_free(&q->pool, tmp);
+    }
+
+    if (q->tm)
+        qtm_on_get(q->tm, wait, depth);
+
+    *got = k;
+    return 1;
+}
+
+void queue_get_stats(queue_t *q, qstats_t *sum) {
+	sum->add_attempts = sum->get_attempts = 0;
+	sum->add_count = sum->get_count = 0;
+
+	pthread_mutex_lock(&q->stats_lock);
+	for (qstats_t *st = q->stats; st; st = st->next) {
+		sum->add_attempts += st->add_attempts;
+		sum->get_attempts += st->get_attempts;
+		sum->add_count += st->add_count;
+		sum->get_count += st->get_count;
+	}
+	pthread_mutex_unlock(&q->stats_lock);
+}
+
 void queue_print_stats(queue_t *q) {
+	qstats_t sum;
+
+	queue_get_stats(q, &sum);
+
 	printf("queue stats: current size %d; attempts: (%ld %ld %ld); counts (%ld %ld %ld)\n",
 		q->count,
-		q->add_attempts, q->get_attempts, q->add_attempts - q->get_attempts,
-		q->add_count, q->get_count, q->add_count -q->get_count);
-}
+		sum.add_attempts, sum.get_attempts, sum.add_attempts - sum.get_attempts,
+		sum.add_count, sum.get_count, sum.add_count - sum.get_count);
 
+	if (q->spill) {
+		pthread_mutex_lock(&q->lock);
+		printf("spill stats: on disk %ld; spilled %ld; replayed %ld; segments %ld; recycled %ld; failed %ld\n",
+			q->spill->count, q->spill->spilled, q->spill->replayed,
+			q->spill->segments, q->spill->recycled, q->spill->failed);
+		pthread_mutex_unlock(&q->lock);
+	}
+}
@@ -11,34 +11,92 @@
 #include <pthread.h>
 #include <semaphore.h>
 
+#include "qpool.h"
+#include "qtelemetry.h"
+#include "qspill.h"
+#include "qtrace.h"
+
 typedef struct _QueueNode {
 	int val;
 	struct _QueueNode *next;
+#if QTRACE
+	uint64_t stamp;		// when it was added
+#endif
 } qnode_t;
 
+#define CACHE_LINE_SIZE 64
+
+// Statistics of one thread. Each thread that uses the queue gets its own
+// cache line, so counting never bounces lines between producers and
+// consumers. queue_print_stats sums them up.
+typedef struct _QueueStats {
+	long add_attempts;
+	long get_attempts;
+	long add_count;
+	long get_count;
+	struct _QueueStats *next;
+} __attribute__((aligned(CACHE_LINE_SIZE))) qstats_t;
+
 typedef struct _Queue {
-	qnode_t *first;
-	qnode_t *last;
+	// consumer side
+	qnode_t *first __attribute__((aligned(CACHE_LINE_SIZE)));
 
-	pthread_t qmonitor_tid;
+	// producer side
+	qnode_t *last __attribute__((aligned(CACHE_LINE_SIZE)));
 
+	// shared by both sides
+	pthread_mutex_t lock __attribute__((aligned(CACHE_LINE_SIZE)));
 	int count;
 	int max_count;
 
-	// queue statistics
-	long add_attempts;
-	long get_attempts;
-	long add_count;
-	long get_count;
-	sem_t empty;
-    sem_t full;
-	pthread_mutex_t lock;
+	sem_t empty __attribute__((aligned(CACHE_LINE_SIZE)));
+	sem_t full __attribute__((aligned(CACHE_LINE_SIZE)));
+
+	// broadcast when the spill empties; adds that found the disk full
+	// wait on it with lock
+	pthread_cond_t drained;
+
+	// cold: statistics registry
+	pthread_key_t stats_key __attribute__((aligned(CACHE_LINE_SIZE)));
+	pthread_mutex_t stats_lock;
+	qstats_t *stats;
+
+	// histograms published to the QUEUE_TELEMETRY file, NULL when disabled
+	qtm_t *tm;
+
+	// overflow on disk, NULL unless queue_set_spill was called
+	qspill_t *spill;
+
+	// time in queue histogram, NULL unless built with QTRACE=1 and
+	// QUEUE_TRACE is set. Spilled items carry no stamp and are not traced.
+	qtrace_t *trace;
+
+	// nodes are taken from and returned to the pool outside of lock
+	qpool_t pool;
 } queue_t;
 
 queue_t* queue_init(int max_count);
 void queue_destroy(queue_t *q);
 int queue_add(queue_t *q, int val);
 int queue_get(queue_t *q, int *val);
+
+// Batched versions: block until at least one item fits (is available), then
+// move as many as possible under a single lock acquisition.
+// queue_add_n returns how many of vals were added; queue_get_n stores the
+// number of items copied to out in *got.
+int queue_add_n(queue_t *q, const int *vals, int n);
+int queue_get_n(queue_t *q, int *out, int max, int *got);
+
+// Overflow mode: once max_count items are in memory, queue_add stops
+// blocking and appends to segment files in dir (seg_items ints each, 0 for
+// the default) instead. While anything is on disk new items go there too,
+// and queue_get replays them after the in-memory ones, so the order stays
+// FIFO. full counts the items on disk as well, empty only memory slots.
+// Must be called before the queue is used. Returns 0 or an errno.
+int queue_set_spill(queue_t *q, const char *dir, int seg_items);
+
+// Sum of the per-thread statistics at the moment of the call.
+void queue_get_stats(queue_t *q, qstats_t *sum);
 void queue_print_stats(queue_t *q);
 
 #endif		// __FITOS_QUEUE_H__
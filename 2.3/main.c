@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,6 +7,8 @@
 #include <time.h>
 #include <stdbool.h>
 
+#include "topo.h"
+
 #define MAX_STRING_LEN 100
 #define SWAP_PROBABILITY 50
 
@@ -13,6 +16,9 @@ volatile long long iterations[3] = {0};
 volatile long long swap_attempts = 0;
 volatile long long swap_success = 0;
 
+// placement slots: 0-2 counters, swappers from 3 on
+int swap_slot = 3;
+
 typedef struct _Node {
     char value[MAX_STRING_LEN];
     struct _Node* next;
@@ -42,23 +48,6 @@ Node* node_create(const char* value) {
     return n;
 }
 
-void set_cpu(int n) {
-	int err;
-	cpu_set_t cpuset;
-	pthread_t tid = pthread_self();
-
-	CPU_ZERO(&cpuset);
-	CPU_SET(n, &cpuset);
-
-	err = pthread_setaffinity_np(tid, sizeof(cpu_set_t), &cpuset);
-	if (err) {
-		printf("set_cpu: pthread_setaffinity failed for cpu %d\n", n);
-		return;
-	}
-
-	printf("set_cpu: set cpu %d\n", n);
-}
-
 void storage_add(Storage* s, const char* value) {
     Node* new_node = node_create(value);
     
@@ -88,7 +77,7 @@ void* count_increasing(void* arg) {
     Storage* s = (Storage*)arg;
     static __thread int current_index = 0;
 
-    set_cpu(1);
+    place_self(0);
     
     while (1) {
         pthread_rwlock_rdlock(&s->rwlock);
@@ -144,7 +133,7 @@ void* count_decreasing(void* arg) {
     Storage* s = (Storage*)arg;
     static __thread int current_index = 0;
 
-    set_cpu(1);
+    place_self(1);
     
     while (1) {
         pthread_rwlock_rdlock(&s->rwlock);
@@ -200,7 +189,7 @@ void* count_equal(void* arg) {
     Storage* s = (Storage*)arg;
     static __thread int current_index = 0;
 
-    set_cpu(1);
+    place_self(2);
     
     while (1) {
         pthread_rwlock_rdlock(&s->rwlock);
@@ -257,7 +246,7 @@ void* swap_thread(void* arg) {
     static __thread unsigned int seed = 0;
     static __thread int current_index = 0;
 
-    set_cpu(2);
+    place_self(__sync_fetch_and_add(&swap_slot, 1));
     
     if (seed == 0) seed = time(NULL) ^ pthread_self();
     
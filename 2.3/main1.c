@@ -394,14 +394,14 @@ void* stats_thread(void* arg) {
         
         printf("\n=== Статистика за 1 секунду ===\n");
         printf("Всего проходов:          %lld\n", delta_passes);
-        printf("Проходов (возрастание):  %lld\n", atomic_load(&increase_passes));
-        printf("Проходов (убывание):     %lld\n", atomic_load(&decrease_passes));
-        printf("Проходов (равные):       %lld\n", atomic_load(&equal_passes));
+        printf("Проходов (возрастание):  %ld\n", atomic_load(&increase_passes));
+        printf("Проходов (убывание):     %ld\n", atomic_load(&decrease_passes));
+        printf("Проходов (равные):       %ld\n", atomic_load(&equal_passes));
         printf("Сравнений:               %lld\n", delta_comparisons);
         printf("Перестановок:            %lld\n", delta_swaps);
-        printf("Возрастаний:             %lld\n", atomic_load(&increase_count));
-        printf("Убываний:                %lld\n", atomic_load(&decrease_count));
-        printf("Равных:                  %lld\n", atomic_load(&equal_count));
+        printf("Возрастаний:             %ld\n", atomic_load(&increase_count));
+        printf("Убываний:                %ld\n", atomic_load(&decrease_count));
+        printf("Равных:                  %ld\n", atomic_load(&equal_count));
         
         last_total_passes = current_passes;
         last_total_comparisons = current_comparisons;
@@ -472,15 +472,15 @@ int main(int argc, char* argv[]) {
     pthread_join(stats_thread_id, NULL);
     
     printf("\n=== ФИНАЛЬНАЯ СТАТИСТИКА ===\n");
-    printf("Всего проходов:          %lld\n", atomic_load(&total_passes));
-    printf("Проходов (возрастание):  %lld\n", atomic_load(&increase_passes));
-    printf("Проходов (убывание):     %lld\n", atomic_load(&decrease_passes));
-    printf("Проходов (равные):       %lld\n", atomic_load(&equal_passes));
-    printf("Всего сравнений:         %lld\n", atomic_load(&total_comparisons));
-    printf("Всего перестановок:      %lld\n", atomic_load(&total_swaps));
-    printf("Всего возрастаний:       %lld\n", atomic_load(&increase_count));
-    printf("Всего убываний:          %lld\n", atomic_load(&decrease_count));
-    printf("Всего равных:            %lld\n", atomic_load(&equal_count));
+    printf("Всего проходов:          %ld\n", atomic_load(&total_passes));
+    printf("Проходов (возрастание):  %ld\n", atomic_load(&increase_passes));
+    printf("Проходов (убывание):     %ld\n", atomic_load(&decrease_passes));
+    printf("Проходов (равные):       %ld\n", atomic_load(&equal_passes));
+    printf("Всего сравнений:         %ld\n", atomic_load(&total_comparisons));
+    printf("Всего перестановок:      %ld\n", atomic_load(&total_swaps));
+    printf("Всего возрастаний:       %ld\n", atomic_load(&increase_count));
+    printf("Всего убываний:          %ld\n", atomic_load(&decrease_count));
+    printf("Всего равных:            %ld\n", atomic_load(&equal_count));
     
     printf("\nОчистка памяти...\n");
     free_list(list);
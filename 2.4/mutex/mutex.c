@@ -1,6 +1,7 @@
 #include "mutex.h"
 #include "futex.h"
 #include <stdio.h>
+#include <time.h>
 
 #define CAS(ptr, old, new) __sync_val_compare_and_swap(ptr, old, new)
 #define ATOMIC_EXCHANGE(ptr, new) __sync_lock_test_and_set(ptr, new)
@@ -8,16 +9,101 @@
 #define ATOMIC_SUB(ptr, val) __sync_fetch_and_sub(ptr, val)
 #define MEMORY_BARRIER() __sync_synchronize()
 
+#define LOAD_RELAXED(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define STORE_RELAXED(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELAXED)
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+// Тики нужны только для сравнения друг с другом, поэтому TSC подходит
+// без калибровки
+static inline uint64_t mutex_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+// На одном CPU владелец не может работать, пока мы крутимся
+static int mutex_can_spin(void) {
+    static int ncpus;
+
+    if (!ncpus)
+        ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return MUTEX_ADAPTIVE && ncpus > 1;
+}
+
+static inline void mutex_acquired(mutex_t *mutex) {
+    mutex->owner = pthread_self();
+    mutex->acquires++;
+    STORE_RELAXED(&mutex->locked_at, mutex_ticks());
+}
+
+// Крутимся, пока текущий захват длится не дольше удвоенного среднего:
+// тогда владелец, скорее всего, работает и скоро отпустит. Если захват
+// затянулся (владельца вытеснили, или он уснул сам), дальше ждать
+// дешевле во futex_wait. Возвращает 1, если мьютекс наш.
+static int mutex_spin(mutex_t *mutex) {
+    uint64_t budget = 2 * LOAD_RELAXED(&mutex->hold_avg) + MUTEX_SPIN_MIN;
+
+    if (budget > MUTEX_SPIN_MAX)
+        budget = MUTEX_SPIN_MAX;
+
+    while (1) {
+        uint32_t state = mutex->state;
+
+        if (state == MUTEX_UNLOCKED) {
+            if (CAS(&mutex->state, MUTEX_UNLOCKED, MUTEX_LOCKED) == MUTEX_UNLOCKED)
+                return 1;
+            continue;
+        }
+
+        if (mutex_ticks() - LOAD_RELAXED(&mutex->locked_at) > budget)
+            return 0;
+
+        cpu_relax();
+    }
+}
+
 void mutex_init(mutex_t *mutex) {
     mutex->state = MUTEX_UNLOCKED;
+    mutex->locked_at = 0;
+    mutex->hold_avg = 0;
+    mutex->acquires = 0;
+    mutex->spin_acquired = mutex->spin_failed = mutex->slept = 0;
 }
 
 void mutex_lock(mutex_t *mutex) {
+    int spun = 0, slept = 0;
+
     if (CAS(&mutex->state, MUTEX_UNLOCKED, MUTEX_LOCKED) == MUTEX_UNLOCKED) {
         MEMORY_BARRIER();
-        mutex->owner = pthread_self();
+        mutex_acquired(mutex);
         return;
     }
+
+    if (mutex_can_spin()) {
+        spun = 1;
+
+        if (mutex_spin(mutex)) {
+            MEMORY_BARRIER();
+            mutex_acquired(mutex);
+            mutex->spin_acquired++;
+            return;
+        }
+    }
     
     while (1) {
         uint32_t old_state = mutex->state;
@@ -25,6 +111,15 @@ void mutex_lock(mutex_t *mutex) {
         if (old_state == MUTEX_UNLOCKED) {
             if (CAS(&mutex->state, MUTEX_UNLOCKED, MUTEX_LOCKED_WITH_WAITERS) == MUTEX_UNLOCKED) {
                 MEMORY_BARRIER();
+                mutex_acquired(mutex);
+                // бюджет мог кончиться перед самым освобождением: тогда
+                // захватили без сна, и кручение все-таки помогло
+                if (spun && !slept)
+                    mutex->spin_acquired++;
+                else if (spun)
+                    mutex->spin_failed++;
+                else if (slept)
+                    mutex->slept++;
                 return;
             }
             continue;
@@ -35,12 +130,14 @@ void mutex_lock(mutex_t *mutex) {
         }
         
         futex_wait(&mutex->state, MUTEX_LOCKED_WITH_WAITERS);
+        slept = 1;
     }
 }
 
 int mutex_trylock(mutex_t *mutex) {
     if (CAS(&mutex->state, MUTEX_UNLOCKED, MUTEX_LOCKED) == MUTEX_UNLOCKED) {
         MEMORY_BARRIER();
+        mutex_acquired(mutex);
         return 1;
     }
     return 0;
@@ -51,10 +148,24 @@ void mutex_unlock(mutex_t *mutex) {
     if (mutex->state == MUTEX_UNLOCKED || mutex->owner != pthread_self()) {
         perror("Mutex error");
     }
+
+    int64_t hold = mutex_ticks() - mutex->locked_at;
+    int64_t avg = mutex->hold_avg;
+
+    STORE_RELAXED(&mutex->hold_avg, avg + (hold - avg) / 8);
     
     uint32_t old_state = ATOMIC_EXCHANGE(&mutex->state, MUTEX_UNLOCKED);
     
     if (old_state == MUTEX_LOCKED_WITH_WAITERS) {
         futex_wake(&mutex->state, 1);
     }
-}
\ No newline at end of file
+}
+
+void mutex_print_stats(mutex_t *mutex) {
+    long spun = mutex->spin_acquired + mutex->spin_failed;
+
+    printf("mutex stats: acquires %ld; spin acquired %ld, failed %ld (%.1f%% success); slept %ld; hold avg %lu ticks\n",
+        mutex->acquires, mutex->spin_acquired, mutex->spin_failed,
+        spun ? 100.0 * mutex->spin_acquired / spun : 0.0,
+        mutex->slept, (unsigned long)LOAD_RELAXED(&mutex->hold_avg));
+}
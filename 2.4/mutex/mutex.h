@@ -9,9 +9,31 @@
 #define MUTEX_LOCKED 1
 #define MUTEX_LOCKED_WITH_WAITERS 2
 
+// Адаптивное ожидание: перед futex_wait поток крутится, пока владелец,
+// судя по средней длительности захвата, вот-вот отпустит мьютекс.
+// -DMUTEX_ADAPTIVE=0 сразу засыпает, как раньше.
+#ifndef MUTEX_ADAPTIVE
+#define MUTEX_ADAPTIVE 1
+#endif
+
+// Пределы ожидания в тиках (TSC на x86, иначе наносекунды). Дольше
+// MUTEX_SPIN_MAX крутиться не стоит: сон и пробуждение дешевле.
+#define MUTEX_SPIN_MIN 500
+#define MUTEX_SPIN_MAX 20000
+
 typedef struct {
     volatile uint32_t state;
     pthread_t owner;
+
+    // пишет только владелец
+    uint64_t locked_at;         // когда захвачен, в тиках
+    uint64_t hold_avg;          // скользящее среднее времени захвата, вес 1/8
+
+    // статистика, тоже меняется только владельцем
+    long acquires;
+    long spin_acquired;         // дождались, не засыпая
+    long spin_failed;           // крутились, но все равно уснули
+    long slept;                 // уснули, не крутясь
 } mutex_t;
 
 #define MUTEX_INIT {MUTEX_UNLOCKED}
@@ -20,5 +42,6 @@ void mutex_init(mutex_t *mutex);
 void mutex_lock(mutex_t *mutex);
 void mutex_unlock(mutex_t *mutex);
 int mutex_trylock(mutex_t *mutex);
+void mutex_print_stats(mutex_t *mutex);
 
-#endif
\ No newline at end of file
+#endif
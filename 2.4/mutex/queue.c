@@ -35,7 +35,8 @@ queue_t* queue_init(int max_count) {
 
     LOCK_INIT(&q->lock);
 
-    err = pthread_create(&q->qmonitor_tid, NULL, qmonitor, q);
+    q->monitor = getenv(QMONITOR_ENV) != NULL;
+    err = q->monitor ? pthread_create(&q->qmonitor_tid, NULL, qmonitor, q) : 0;
     if (err) {
         printf("queue_init: pthread_create() failed: %s\n", strerror(err));
         free(q);
@@ -48,8 +49,10 @@ queue_t* queue_init(int max_count) {
 void queue_destroy(queue_t *q) {
     if (q == NULL) return;
     
-    pthread_cancel(q->qmonitor_tid);
-    pthread_join(q->qmonitor_tid, NULL);
+    if (q->monitor) {
+        pthread_cancel(q->qmonitor_tid);
+        pthread_join(q->qmonitor_tid, NULL);
+    }
         
     qnode_t *current = q->first;
     while (current != NULL) {
@@ -130,6 +133,7 @@ void queue_print_stats(queue_t *q) {
         q->count,
         q->add_attempts, q->get_attempts, q->add_attempts - q->get_attempts,
         q->add_count, q->get_count, q->add_count - q->get_count);
+    mutex_print_stats(&q->lock);
     
     UNLOCK(&q->lock);
 }
\ No newline at end of file
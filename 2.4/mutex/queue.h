@@ -8,6 +8,7 @@
 #include <pthread.h>
 #include <unistd.h>
 #include "mutex.h"
+#include "qmonitor.h"
 
 typedef struct _qnode {
     int val;
@@ -24,6 +25,7 @@ typedef struct queue {
     long add_count;
     long get_count;
     pthread_t qmonitor_tid;
+    int monitor;
     mutex_t lock;
 } queue_t;
 
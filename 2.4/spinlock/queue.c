@@ -1,9 +1,10 @@
 #include "queue.h"
 
-#define LOCK_INIT(lock) spinlock_init(lock)
-#define LOCK(lock) spinlock_lock(lock)
-#define UNLOCK(lock) spinlock_unlock(lock)
-#define TRY_LOCK(lock) spinlock_trylock(lock)
+#define LOCK_INIT(l) QLOCK(QUEUE_LOCK, init)(l)
+#define LOCK_DESTROY(l) QLOCK(QUEUE_LOCK, destroy)(l)
+#define LOCK(l) QLOCK(QUEUE_LOCK, lock)(l)
+#define UNLOCK(l) QLOCK(QUEUE_LOCK, unlock)(l)
+#define TRY_LOCK(l) QLOCK(QUEUE_LOCK, trylock)(l)
 
 void *qmonitor(void *arg) {
     queue_t *q = (queue_t *)arg;
@@ -35,7 +36,8 @@ queue_t* queue_init(int max_count) {
 
     LOCK_INIT(&q->lock);
 
-    err = pthread_create(&q->qmonitor_tid, NULL, qmonitor, q);
+    q->monitor = getenv(QMONITOR_ENV) != NULL;
+    err = q->monitor ? pthread_create(&q->qmonitor_tid, NULL, qmonitor, q) : 0;
     if (err) {
         printf("queue_init: pthread_create() failed: %s\n", strerror(err));
         free(q);
@@ -48,8 +50,10 @@ queue_t* queue_init(int max_count) {
 void queue_destroy(queue_t *q) {
     if (q == NULL) return;
     
-    pthread_cancel(q->qmonitor_tid);
-    pthread_join(q->qmonitor_tid, NULL);
+    if (q->monitor) {
+        pthread_cancel(q->qmonitor_tid);
+        pthread_join(q->qmonitor_tid, NULL);
+    }
         
     qnode_t *current = q->first;
     while (current != NULL) {
@@ -57,7 +61,8 @@ void queue_destroy(queue_t *q) {
         current = current->next;
         free(temp);
     }
-    
+
+    LOCK_DESTROY(&q->lock);
     free(q);
 }
 
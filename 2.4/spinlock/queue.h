@@ -8,6 +8,19 @@
 #include <pthread.h>
 #include <unistd.h>
 #include "spinlock.h"
+#include "qmonitor.h"
+
+// Lock of the queue, chosen when compiling: -DQUEUE_LOCK=spin (default),
+// ticket, mcs or clh picks spinlock_t, ticketlock_t, mcslock_t or
+// clhlock_t and their functions.
+#ifndef QUEUE_LOCK
+#define QUEUE_LOCK spin
+#endif
+
+#define QLOCK_PASTE(kind, name) kind##lock_##name
+#define QLOCK(kind, name) QLOCK_PASTE(kind, name)
+
+typedef QLOCK(QUEUE_LOCK, t) qlock_t;
 
 typedef struct _qnode {
     int val;
@@ -24,7 +37,8 @@ typedef struct queue {
     long add_count;
     long get_count;
     pthread_t qmonitor_tid;
-    spinlock_t lock;
+    int monitor;
+    qlock_t lock;
 } queue_t;
 
 queue_t* queue_init(int max_count);
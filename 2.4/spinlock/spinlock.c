@@ -1,32 +1,357 @@
 #include "spinlock.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
 
-#define CAS(ptr, old, new) __sync_val_compare_and_swap(ptr, old, new)
 #define ATOMIC_EXCHANGE(ptr, new) __sync_lock_test_and_set(ptr, new)
-#define MEMORY_BARRIER() __sync_synchronize()
+
+#define LOAD_RELAXED(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define LOAD_ACQUIRE(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define STORE_RELAXED(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELAXED)
+#define STORE_RELEASE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+// Состояние генератора для случайных пауз, свое у каждого потока
+static __thread uint32_t backoff_seed;
+
+static inline uint32_t backoff_random(void) {
+    uint32_t x = backoff_seed;
+
+    if (!x)
+        x = (uint32_t)(uintptr_t)&backoff_seed | 1;
+
+    // xorshift32
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    backoff_seed = x;
+    return x;
+}
 
 void spinlock_init(spinlock_t *lock) {
     lock->lock = 0;
+    lock->backoff_min = SPINLOCK_BACKOFF_MIN;
+    lock->backoff_max = SPINLOCK_BACKOFF_MAX;
+    lock->acquires = lock->contended = lock->spins = 0;
+}
+
+void spinlock_destroy(spinlock_t *lock) {
+    (void)lock;
 }
 
+void spinlock_set_backoff(spinlock_t *lock, int min, int max) {
+    lock->backoff_min = min < 1 ? 1 : min;
+    lock->backoff_max = max;
+}
+
+// TTAS: пока лок занят, ждем чтением, не трогая линию кэша записью, и
+// только увидев его свободным, пробуем взять. Если не вышло, значит
+// кто-то успел раньше: ждем случайное число пауз, каждый раз до вдвое
+// большего предела, чтобы ждущие не бросались на лок все разом.
 void spinlock_lock(spinlock_t *lock) {
-    while (1) {
-        if (CAS(&lock->lock, 0, 1) == 0) {
-            MEMORY_BARRIER();
-            return;
+    int limit = lock->backoff_min;
+    long spins = 0;
+
+    while (LOAD_RELAXED(&lock->lock) || ATOMIC_EXCHANGE(&lock->lock, 1)) {
+        if (lock->backoff_max > 0 && spins) {
+            int n = 1 + backoff_random() % limit;
+
+            for (int i = 0; i < n; i++)
+                cpu_relax();
+            spins += n;
+
+            if (limit < lock->backoff_max)
+                limit = limit * 2 < lock->backoff_max ? limit * 2 : lock->backoff_max;
         }
+
+        do {
+            cpu_relax();
+            spins++;
+        } while (LOAD_RELAXED(&lock->lock));
+    }
+
+    // счетчики меняет только владелец
+    lock->acquires++;
+    if (spins) {
+        lock->contended++;
+        lock->spins += spins;
     }
 }
 
 int spinlock_trylock(spinlock_t *lock) {
-    if (CAS(&lock->lock, 0, 1) == 0) {
-        MEMORY_BARRIER();
-        return 1;
-    }
-    return 0;
+    if (LOAD_RELAXED(&lock->lock) || ATOMIC_EXCHANGE(&lock->lock, 1))
+        return 0;
+
+    lock->acquires++;
+    return 1;
 }
 
 void spinlock_unlock(spinlock_t *lock) {
-    MEMORY_BARRIER();
-    lock->lock = 0;
-}
\ No newline at end of file
+    __sync_lock_release(&lock->lock);
+}
+
+void spinlock_print_stats(spinlock_t *lock) {
+    long acquires = LOAD_RELAXED(&lock->acquires);
+    long contended = LOAD_RELAXED(&lock->contended);
+    long spins = LOAD_RELAXED(&lock->spins);
+
+    printf("spinlock stats: acquires %ld; contended %ld; spins per acquire %.1f\n",
+        acquires, contended, acquires ? (double)spins / acquires : 0.0);
+}
+
+// Ожидание в очереди: сначала крутимся, потом уступаем CPU. Иначе поток,
+// которому передали лок, может долго не получить процессор, пока его
+// соседи по очереди докручивают свои кванты.
+static inline void spin_pause(int *spins) {
+    if (++*spins < SPINLOCK_SPINS)
+        cpu_relax();
+    else
+        sched_yield();
+}
+
+void ticketlock_init(ticketlock_t *lock) {
+    lock->next = 0;
+    lock->serving = 0;
+}
+
+void ticketlock_destroy(ticketlock_t *lock) {
+    (void)lock;
+}
+
+void ticketlock_lock(ticketlock_t *lock) {
+    uint32_t ticket = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+    int spins = 0;
+
+    while (LOAD_ACQUIRE(&lock->serving) != ticket)
+        spin_pause(&spins);
+}
+
+int ticketlock_trylock(ticketlock_t *lock) {
+    uint32_t serving = LOAD_ACQUIRE(&lock->serving);
+    uint32_t ticket = serving;
+
+    // свободен, только если следующий номер и есть обслуживаемый
+    return __atomic_compare_exchange_n(&lock->next, &ticket, serving + 1, 0,
+        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+void ticketlock_unlock(ticketlock_t *lock) {
+    // serving меняет только владелец
+    STORE_RELEASE(&lock->serving, LOAD_RELAXED(&lock->serving) + 1);
+}
+
+// Узлы MCS живут в потоке и берутся по стеку: глубина - число MCS
+// локов, которые поток сейчас держит.
+static __thread lock_node_t mcs_nodes[SPINLOCK_NEST];
+static __thread int mcs_depth;
+
+static lock_node_t *mcs_node_get(void) {
+    if (mcs_depth == SPINLOCK_NEST) {
+        printf("mcslock: more than %d locks held\n", SPINLOCK_NEST);
+        abort();
+    }
+
+    return &mcs_nodes[mcs_depth++];
+}
+
+void mcslock_init(mcslock_t *lock) {
+    lock->tail = NULL;
+    lock->holder = NULL;
+}
+
+// Узлы MCS лежат в самом потоке, освобождать нечего
+void mcslock_destroy(mcslock_t *lock) {
+    (void)lock;
+}
+
+void mcslock_lock(mcslock_t *lock) {
+    lock_node_t *me = mcs_node_get();
+    lock_node_t *pred;
+    int spins = 0;
+
+    me->next = NULL;
+    me->locked = 1;
+
+    pred = __atomic_exchange_n(&lock->tail, me, __ATOMIC_ACQ_REL);
+    if (pred) {
+        STORE_RELEASE(&pred->next, me);
+
+        while (LOAD_ACQUIRE(&me->locked))
+            spin_pause(&spins);
+    }
+
+    lock->holder = me;
+}
+
+int mcslock_trylock(mcslock_t *lock) {
+    lock_node_t *me = mcs_node_get();
+    lock_node_t *empty = NULL;
+
+    me->next = NULL;
+    me->locked = 0;
+
+    if (!__atomic_compare_exchange_n(&lock->tail, &empty, me, 0,
+            __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        mcs_depth--;
+        return 0;
+    }
+
+    lock->holder = me;
+    return 1;
+}
+
+void mcslock_unlock(mcslock_t *lock) {
+    lock_node_t *me = lock->holder;
+    lock_node_t *next = LOAD_ACQUIRE(&me->next);
+    int spins = 0;
+
+    if (!next) {
+        lock_node_t *expected = me;
+
+        // никого нет - очередь пуста
+        if (__atomic_compare_exchange_n(&lock->tail, &expected, NULL, 0,
+                __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            mcs_depth--;
+            return;
+        }
+
+        // следующий уже сменил tail, но еще не записал себя в next
+        while (!(next = LOAD_ACQUIRE(&me->next)))
+            spin_pause(&spins);
+    }
+
+    STORE_RELEASE(&next->locked, 0);
+    mcs_depth--;
+}
+
+// Узлы CLH переходят от потока к потоку, поэтому поток хранит только
+// указатели на те, что сейчас его.
+static __thread lock_node_t *clh_nodes[SPINLOCK_NEST];
+static __thread int clh_depth;
+
+// Узлы потока освобождаются при его выходе деструктором ключа. Лок в этот
+// момент поток уже не держит, так что все узлы в clh_nodes - его.
+static pthread_key_t clh_key;
+static pthread_once_t clh_key_once = PTHREAD_ONCE_INIT;
+
+static void clh_nodes_free(void *arg) {
+    lock_node_t **nodes = (lock_node_t **)arg;
+
+    for (int i = 0; i < SPINLOCK_NEST; i++) {
+        free(nodes[i]);
+        nodes[i] = NULL;
+    }
+}
+
+static void clh_key_create(void) {
+    int err = pthread_key_create(&clh_key, clh_nodes_free);
+
+    if (err) {
+        printf("clhlock: pthread_key_create failed: %s\n", strerror(err));
+        abort();
+    }
+}
+
+static lock_node_t *clh_node_new(void) {
+    lock_node_t *node;
+
+    if (posix_memalign((void **)&node, CACHE_LINE_SIZE, sizeof(lock_node_t))) {
+        printf("Cannot allocate memory for a lock node\n");
+        abort();
+    }
+
+    node->next = NULL;
+    node->locked = 0;
+    return node;
+}
+
+static lock_node_t *clh_node_get(void) {
+    if (clh_depth == SPINLOCK_NEST) {
+        printf("clhlock: more than %d locks held\n", SPINLOCK_NEST);
+        abort();
+    }
+
+    if (!clh_nodes[clh_depth]) {
+        pthread_once(&clh_key_once, clh_key_create);
+        pthread_setspecific(clh_key, clh_nodes);
+        clh_nodes[clh_depth] = clh_node_new();
+    }
+
+    return clh_nodes[clh_depth++];
+}
+
+void clhlock_init(clhlock_t *lock) {
+    lock->tail = clh_node_new();
+    lock->holder = NULL;
+    lock->holder_pred = NULL;
+}
+
+// Лок должен быть свободен. Узел в tail не принадлежит ни одному потоку:
+// последний отпустивший забрал себе узел предшественника.
+void clhlock_destroy(clhlock_t *lock) {
+    free(lock->tail);
+    lock->tail = NULL;
+}
+
+void clhlock_lock(clhlock_t *lock) {
+    lock_node_t *me = clh_node_get();
+    lock_node_t *pred;
+    int spins = 0;
+
+    STORE_RELAXED(&me->locked, 1);
+
+    pred = __atomic_exchange_n(&lock->tail, me, __ATOMIC_ACQ_REL);
+    while (LOAD_ACQUIRE(&pred->locked))
+        spin_pause(&spins);
+
+    lock->holder = me;
+    lock->holder_pred = pred;
+}
+
+// Хвост со снятым флагом значит, что лок свободен. Между проверкой и CAS
+// хвостовой узел может уйти и вернуться уже занятым, так что после CAS
+// флаг предшественника все равно нужно дождаться; обычно он уже снят.
+int clhlock_trylock(clhlock_t *lock) {
+    lock_node_t *pred = LOAD_ACQUIRE(&lock->tail);
+    lock_node_t *me;
+    int spins = 0;
+
+    if (LOAD_ACQUIRE(&pred->locked))
+        return 0;
+
+    me = clh_node_get();
+    STORE_RELAXED(&me->locked, 1);
+
+    if (!__atomic_compare_exchange_n(&lock->tail, &pred, me, 0,
+            __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        clh_depth--;
+        return 0;
+    }
+
+    while (LOAD_ACQUIRE(&pred->locked))
+        spin_pause(&spins);
+
+    lock->holder = me;
+    lock->holder_pred = pred;
+    return 1;
+}
+
+void clhlock_unlock(clhlock_t *lock) {
+    lock_node_t *me = lock->holder;
+
+    // узел предшественника больше никому не нужен - он теперь наш
+    clh_nodes[--clh_depth] = lock->holder_pred;
+    STORE_RELEASE(&me->locked, 0);
+}
@@ -3,18 +3,95 @@
 
 #include <stdint.h>
 
-// Структура спинлока - просто целое число
+#define CACHE_LINE_SIZE 64
+
+// Сколько раз ждущий поток проверяет свой флаг, прежде чем уступить CPU
+#define SPINLOCK_SPINS 100
+
+// Сколько разных MCS/CLH локов поток может держать одновременно.
+// Отпускать их нужно в обратном порядке.
+#define SPINLOCK_NEST 4
+
+// Пределы случайной паузы спинлока после проигранной попытки, в паузах
+// процессора. Предел удваивается с каждой неудачей до максимума.
+#define SPINLOCK_BACKOFF_MIN 4
+#define SPINLOCK_BACKOFF_MAX 1024
+
+// Структура спинлока - целое число, настройки паузы и счетчики.
+// Счетчики меняет только владелец лока.
 typedef struct {
     volatile int lock;
+    int backoff_min;
+    int backoff_max;
+
+    long acquires;
+    long contended;     // захваты, которым пришлось ждать
+    long spins;         // паузы процессора за все ожидания
 } spinlock_t;
 
 // Инициализация спинлока
-#define SPINLOCK_INIT {0}
+#define SPINLOCK_INIT {0, SPINLOCK_BACKOFF_MIN, SPINLOCK_BACKOFF_MAX, 0, 0, 0}
 
 // Функции работы со спинлоком
 void spinlock_init(spinlock_t *lock);
+void spinlock_destroy(spinlock_t *lock);
 void spinlock_lock(spinlock_t *lock);
 void spinlock_unlock(spinlock_t *lock);
 int spinlock_trylock(spinlock_t *lock);
 
-#endif
\ No newline at end of file
+// max 0 выключает паузы: остается чистый TTAS
+void spinlock_set_backoff(spinlock_t *lock, int min, int max);
+void spinlock_print_stats(spinlock_t *lock);
+
+// Тикетный лок: поток берет номер из next и ждет, пока serving не дойдет
+// до него. Лок достается строго в порядке очереди, но все ждут на одной
+// линии кэша.
+typedef struct {
+    uint32_t next;
+    uint32_t serving;
+} ticketlock_t;
+
+#define TICKETLOCK_INIT {0, 0}
+
+void ticketlock_init(ticketlock_t *lock);
+void ticketlock_destroy(ticketlock_t *lock);
+void ticketlock_lock(ticketlock_t *lock);
+void ticketlock_unlock(ticketlock_t *lock);
+int ticketlock_trylock(ticketlock_t *lock);
+
+// Узел очереди MCS и CLH. Каждый узел на своей линии кэша, так что
+// ждущие потоки не мешают друг другу.
+typedef struct _lock_node {
+    struct _lock_node *next;
+    int locked;
+} __attribute__((aligned(CACHE_LINE_SIZE))) lock_node_t;
+
+// MCS: tail - последний в очереди. Поток ставит свой узел в хвост и крутится
+// на его флаге, пока предшественник не передаст ему лок через next.
+typedef struct {
+    lock_node_t *tail;
+    lock_node_t *holder;
+} mcslock_t;
+
+void mcslock_init(mcslock_t *lock);
+void mcslock_destroy(mcslock_t *lock);
+void mcslock_lock(mcslock_t *lock);
+void mcslock_unlock(mcslock_t *lock);
+int mcslock_trylock(mcslock_t *lock);
+
+// CLH: поток ставит свой узел в хвост и крутится на флаге предыдущего.
+// Отпуская лок, он забирает себе узел предшественника. tail никогда не
+// пуст: clhlock_init кладет туда свободный узел.
+typedef struct {
+    lock_node_t *tail;
+    lock_node_t *holder;
+    lock_node_t *holder_pred;
+} clhlock_t;
+
+void clhlock_init(clhlock_t *lock);
+void clhlock_destroy(clhlock_t *lock);
+void clhlock_lock(clhlock_t *lock);
+void clhlock_unlock(clhlock_t *lock);
+int clhlock_trylock(clhlock_t *lock);
+
+#endif
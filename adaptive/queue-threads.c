@@ -0,0 +1,86 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "queue.h"
+#include "topo.h"
+
+#define RED "\033[41m"
+#define NOCOLOR "\033[0m"
+
+void *reader(void *arg) {
+	int expected = 0;
+	queue_t *q = (queue_t *)arg;
+	printf("reader [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	place_self(0);
+
+	while (1) {
+		int val = -1;
+		int ok = queue_get(q, &val);
+		if (!ok)
+			continue;
+
+		if (expected != val)
+			printf(RED"ERROR: get value is %d but expected - %d" NOCOLOR "\n", val, expected);
+
+		expected = val + 1;
+	}
+
+	return NULL;
+}
+
+void *writer(void *arg) {
+	int i = 0;
+	queue_t *q = (queue_t *)arg;
+	printf("writer [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	place_self(1);
+
+	while (1) {
+		int ok = queue_add(q, i);
+		if (!ok)
+			continue;
+		i++;
+	}
+
+	return NULL;
+}
+
+int main() {
+	pthread_t tid;
+	queue_t *q;
+	int err;
+
+	printf("main [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	q = queue_init(1000000);
+
+	err = pthread_create(&tid, NULL, reader, q);
+	if (err) {
+		printf("main: pthread_create() failed: %s\n", strerror(err));
+		return -1;
+	}
+
+	sched_yield();
+
+	err = pthread_create(&tid, NULL, writer, q);
+	if (err) {
+		printf("main: pthread_create() failed: %s\n", strerror(err));
+		return -1;
+	}
+
+	// TODO: join threads
+
+	pthread_exit(NULL);
+
+	return 0;
+}
@@ -0,0 +1,178 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <assert.h>
+
+#include "queue.h"
+
+void *qmonitor(void *arg) {
+	queue_t *q = (queue_t *)arg;
+
+	printf("qmonitor: [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	while (1) {
+		queue_print_stats(q);
+		sleep(1);
+	}
+
+	return NULL;
+}
+
+queue_t* queue_init(int max_count) {
+    qwait_policy_t policy = { QWAIT_SPIN_MAX, QWAIT_YIELDS, 1 };
+    int err;
+    queue_t *q;
+
+    err = posix_memalign((void **)&q, CACHE_LINE_SIZE, sizeof(queue_t));
+    if (err) {
+        printf("Cannot allocate memory for a queue\n");
+        abort();
+    }
+
+    q->first = NULL;
+    q->last = NULL;
+    q->max_count = max_count;
+    q->count = 0;
+
+    q->add_attempts = q->get_attempts = 0;
+    q->add_count = q->get_count = 0;
+
+    q->policy = policy;
+    qwait_init(&q->not_empty, &q->policy);
+    qwait_init(&q->not_full, &q->policy);
+
+    err = pthread_mutex_init(&q->lock, NULL);
+    if (err) {
+        printf("queue_init: pthread_mutex_init failed: %s\n", strerror(err));
+        free(q);
+        abort();
+    }
+
+    q->monitor = getenv(QMONITOR_ENV) != NULL;
+    err = q->monitor ? pthread_create(&q->qmonitor_tid, NULL, qmonitor, q) : 0;
+    if (err) {
+        printf("queue_init: pthread_create() failed: %s\n", strerror(err));
+        pthread_mutex_destroy(&q->lock);
+        free(q);
+        abort();
+    }
+
+    return q;
+}
+
+void queue_destroy(queue_t *q) {
+    if (q == NULL) return;
+
+    if (q->monitor) {
+        pthread_cancel(q->qmonitor_tid);
+        pthread_join(q->qmonitor_tid, NULL);
+    }
+
+    pthread_mutex_destroy(&q->lock);
+
+    qnode_t *current = q->first;
+    while (current != NULL) {
+        qnode_t *temp = current;
+        current = current->next;
+        free(temp);
+    }
+
+    free(q);
+}
+
+// Threads may be waiting right now and read the policy without the lock,
+// so only the policy and the spin tuning change, never the wait state.
+void queue_set_wait_policy(queue_t *q, const qwait_policy_t *policy) {
+    qwait_policy_t p = *policy;
+
+    if (p.spin < QWAIT_SPIN_MIN)
+        p.spin = QWAIT_SPIN_MIN;
+
+    pthread_mutex_lock(&q->lock);
+
+    __atomic_store_n(&q->policy.spin, p.spin, __ATOMIC_RELAXED);
+    __atomic_store_n(&q->policy.yields, p.yields, __ATOMIC_RELAXED);
+    __atomic_store_n(&q->policy.adaptive, p.adaptive, __ATOMIC_RELAXED);
+
+    qwait_set_policy(&q->not_empty, &p);
+    qwait_set_policy(&q->not_full, &p);
+
+    pthread_mutex_unlock(&q->lock);
+}
+
+int queue_add(queue_t *q, int val) {
+    qnode_t *new = malloc(sizeof(qnode_t));
+    if (!new) {
+        printf("Cannot allocate memory for new node\n");
+        abort();
+    }
+
+    new->val = val;
+    new->next = NULL;
+
+    pthread_mutex_lock(&q->lock);
+
+    while (q->count == q->max_count) {
+        uint32_t seq = qwait_prepare(&q->not_full);
+
+        pthread_mutex_unlock(&q->lock);
+        qwait(&q->not_full, seq, &q->policy);
+        pthread_mutex_lock(&q->lock);
+    }
+
+    q->add_attempts++;
+
+    assert(q->count < q->max_count);
+
+    if (!q->first)
+        q->first = q->last = new;
+    else {
+        q->last->next = new;
+        q->last = q->last->next;
+    }
+
+    q->count++;
+    q->add_count++;
+
+    pthread_mutex_unlock(&q->lock);
+    qwake(&q->not_empty);
+    return 1;
+}
+
+int queue_get(queue_t *q, int *val) {
+    pthread_mutex_lock(&q->lock);
+
+    while (q->count == 0) {
+        uint32_t seq = qwait_prepare(&q->not_empty);
+
+        pthread_mutex_unlock(&q->lock);
+        qwait(&q->not_empty, seq, &q->policy);
+        pthread_mutex_lock(&q->lock);
+    }
+
+    q->get_attempts++;
+
+    assert(q->count > 0);
+
+    qnode_t *tmp = q->first;
+    *val = tmp->val;
+    q->first = q->first->next;
+
+    q->count--;
+    q->get_count++;
+
+    pthread_mutex_unlock(&q->lock);
+    qwake(&q->not_full);
+
+    free(tmp);
+    return 1;
+}
+
+void queue_print_stats(queue_t *q) {
+	printf("queue stats: current size %d; attempts: (%ld %ld %ld); counts (%ld %ld %ld)\n",
+		q->count,
+		q->add_attempts, q->get_attempts, q->add_attempts - q->get_attempts,
+		q->add_count, q->get_count, q->add_count -q->get_count);
+	printf("wait stats: get spin/yield/park (%ld %ld %ld) budget %d; add spin/yield/park (%ld %ld %ld) budget %d\n",
+		q->not_empty.spin_hits, q->not_empty.yield_hits, q->not_empty.park_hits, q->not_empty.budget,
+		q->not_full.spin_hits, q->not_full.yield_hits, q->not_full.park_hits, q->not_full.budget);
+}
@@ -0,0 +1,56 @@
+#ifndef __FITOS_QUEUE_H__
+#define __FITOS_QUEUE_H__
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "qwait.h"
+#include "qmonitor.h"
+
+#define CACHE_LINE_SIZE 64
+
+typedef struct _QueueNode {
+	int val;
+	struct _QueueNode *next;
+} qnode_t;
+
+// Blocking queue like 2.2f, but add and get wait according to a
+// qwait_policy_t (spin, then yield, then futex) instead of a condvar.
+typedef struct _Queue {
+	qnode_t *first;
+	qnode_t *last;
+
+	pthread_t qmonitor_tid;
+	int monitor;
+
+	int count;
+	int max_count;
+
+	// queue statistics
+	long add_attempts;
+	long get_attempts;
+	long add_count;
+	long get_count;
+	pthread_mutex_t lock;
+
+	qwait_policy_t policy;
+	qwaiter_t not_empty __attribute__((aligned(CACHE_LINE_SIZE)));
+	qwaiter_t not_full __attribute__((aligned(CACHE_LINE_SIZE)));
+} queue_t;
+
+queue_t* queue_init(int max_count);
+void queue_destroy(queue_t *q);
+int queue_add(queue_t *q, int val);
+int queue_get(queue_t *q, int *val);
+void queue_print_stats(queue_t *q);
+
+// Takes effect for waits that start after the call.
+void queue_set_wait_policy(queue_t *q, const qwait_policy_t *policy);
+
+#endif		// __FITOS_QUEUE_H__
@@ -0,0 +1,125 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <linux/futex.h>
+
+#include "qwait.h"
+#include "futex.h"
+
+#define LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_SEQ_CST)
+#define LOAD_RELAXED(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define STORE_RELAXED(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELAXED)
+#define ATOMIC_ADD(ptr, val) __atomic_add_fetch(ptr, val, __ATOMIC_SEQ_CST)
+#define ATOMIC_INC(ptr) __atomic_fetch_add(ptr, 1, __ATOMIC_RELAXED)
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#else
+	__asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+static int clamp(int v, int lo, int hi) {
+	return v < lo ? lo : v > hi ? hi : v;
+}
+
+void qwait_init(qwaiter_t *w, const qwait_policy_t *policy) {
+	w->seq = 0;
+	w->waiters = 0;
+	w->sleepers = 0;
+
+	w->budget = policy->spin;
+	w->avg_spins = policy->spin / 2;
+
+	w->spin_hits = w->yield_hits = w->park_hits = 0;
+}
+
+// Restarts the spin tuning for a new policy. Safe while threads wait:
+// seq, waiters and sleepers are left alone.
+void qwait_set_policy(qwaiter_t *w, const qwait_policy_t *policy) {
+	STORE_RELAXED(&w->budget, policy->spin);
+	STORE_RELAXED(&w->avg_spins, policy->spin / 2);
+}
+
+// Must be called under the queue lock, before the caller checks the queue
+// state, so a wakeup that happens between the check and qwait() is not
+// lost. Every qwait_prepare must be followed by qwait.
+uint32_t qwait_prepare(qwaiter_t *w) {
+	ATOMIC_ADD(&w->waiters, 1);
+	return LOAD(&w->seq);
+}
+
+// Budget updates race between waiters; losing one of them is harmless.
+static void qwait_tune(qwaiter_t *w, int spins, const qwait_policy_t *policy) {
+	int avg = LOAD_RELAXED(&w->avg_spins);
+
+	avg += (spins - avg) / 8;
+	STORE_RELAXED(&w->avg_spins, avg);
+	STORE_RELAXED(&w->budget, clamp(2 * avg + QWAIT_SPIN_MIN, QWAIT_SPIN_MIN, policy->spin));
+}
+
+// The wait outlasted the spin phase: either the other side needed this
+// CPU to make progress or the gap was long. Both mean spin less next time.
+static void qwait_shrink(qwaiter_t *w, int budget, const qwait_policy_t *policy) {
+	if (!policy->adaptive)
+		return;
+
+	STORE_RELAXED(&w->avg_spins, budget / 4);
+	STORE_RELAXED(&w->budget, clamp(budget / 2, QWAIT_SPIN_MIN, policy->spin));
+}
+
+void qwait(qwaiter_t *w, uint32_t seq, const qwait_policy_t *shared) {
+	// the policy may be changed while we wait, work on one snapshot of it
+	qwait_policy_t snap = {
+		LOAD_RELAXED(&shared->spin),
+		LOAD_RELAXED(&shared->yields),
+		LOAD_RELAXED(&shared->adaptive),
+	};
+	const qwait_policy_t *policy = &snap;
+	int budget = policy->adaptive ? LOAD_RELAXED(&w->budget) : policy->spin;
+
+	for (int i = 0; i < budget; i++) {
+		if (LOAD(&w->seq) != seq) {
+			ATOMIC_INC(&w->spin_hits);
+			if (policy->adaptive)
+				qwait_tune(w, i, policy);
+			goto out;
+		}
+		cpu_relax();
+	}
+
+	for (int i = 0; i < policy->yields; i++) {
+		sched_yield();
+		if (LOAD(&w->seq) != seq) {
+			ATOMIC_INC(&w->yield_hits);
+			qwait_shrink(w, budget, policy);
+			goto out;
+		}
+	}
+
+	qwait_shrink(w, budget, policy);
+
+	ATOMIC_ADD(&w->sleepers, 1);
+	while (LOAD(&w->seq) == seq)
+		futex(&w->seq, FUTEX_WAIT_PRIVATE, seq, NULL, NULL, 0);
+	ATOMIC_ADD(&w->sleepers, -1);
+
+	ATOMIC_INC(&w->park_hits);
+out:
+	ATOMIC_ADD(&w->waiters, -1);
+}
+
+// Called after the queue lock is released: a waiter that registered
+// before our critical section is visible here, a later one saw the new
+// queue state and does not wait.
+void qwake(qwaiter_t *w) {
+	if (!LOAD(&w->waiters))
+		return;
+
+	ATOMIC_ADD(&w->seq, 1);
+
+	if (LOAD(&w->sleepers))
+		futex(&w->seq, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
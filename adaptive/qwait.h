@@ -0,0 +1,45 @@
+#ifndef __FITOS_QWAIT_H__
+#define __FITOS_QWAIT_H__
+
+#include <stdint.h>
+
+// Defaults for qwait_policy_t
+#define QWAIT_SPIN_MIN 16
+#define QWAIT_SPIN_MAX 4096
+#define QWAIT_YIELDS 4
+
+// How a blocked thread waits: spin with a pause hint up to spin iterations,
+// then give the CPU away up to yields times, then sleep on a futex.
+// With adaptive set, spin is only the upper bound: every waiter keeps its
+// own budget tuned from how long recent waits took.
+typedef struct _WaitPolicy {
+	int spin;
+	int yields;
+	int adaptive;
+} qwait_policy_t;
+
+// One condition threads wait for ("not empty", "not full"). Waiters
+// register and sample seq with qwait_prepare, recheck the queue and wait
+// for seq to change. qwake is free while nobody is registered.
+typedef struct _Waiter {
+	uint32_t seq;
+	int waiters;
+	int sleepers;
+
+	// adaptive spin budget and moving average of spins needed to succeed
+	int budget;
+	int avg_spins;
+
+	// how many waits ended in each phase
+	long spin_hits;
+	long yield_hits;
+	long park_hits;
+} qwaiter_t;
+
+void qwait_init(qwaiter_t *w, const qwait_policy_t *policy);
+void qwait_set_policy(qwaiter_t *w, const qwait_policy_t *policy);
+uint32_t qwait_prepare(qwaiter_t *w);
+void qwait(qwaiter_t *w, uint32_t seq, const qwait_policy_t *policy);
+void qwake(qwaiter_t *w);
+
+#endif		// __FITOS_QWAIT_H__
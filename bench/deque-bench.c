@@ -0,0 +1,267 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+
+#include "queue.h"
+#include "deque.h"
+#include "topo.h"
+
+// Fork/join benchmark: parallel recursive sum of 0 .. n-1. A task is a
+// node of the implicit binary tree over [0, n) (root 1, children 2k and
+// 2k+1). A worker splits its task, hands the right half out and goes on
+// with the left half until the range is below the cutoff, then sums it.
+//
+// "deque": every worker owns a ../deque, idle workers steal.
+// "queue": all workers share one ../2.2f queue_t.
+//
+// One CSV line per implementation and thread count:
+//
+//	impl,threads,n,cutoff,seconds,tasks,steals,ok
+//
+// Worker i takes placement slot i.
+//
+// Usage: deque-bench [-t threads,...] [-n n] [-c cutoff] [-P placement]
+
+#define POISON -1
+
+typedef struct _Worker {
+	pthread_t tid;
+	int id;
+	unsigned int seed;
+	deque_t *deque;
+	long sum;
+	long tasks;
+} worker_t;
+
+static long n = 1L << 26;
+static long cutoff = 4096;
+static int threads;
+static worker_t *workers;
+static queue_t *shared;
+
+static topo_t topo;
+static place_t place;
+
+// tasks handed out and not finished yet
+static long pending;
+
+static void task_range(long id, long *lo, long *hi) {
+	int depth = 63 - __builtin_clzl(id);
+
+	*lo = 0;
+	*hi = n;
+
+	for (int i = depth - 1; i >= 0; i--) {
+		long mid = *lo + (*hi - *lo) / 2;
+
+		if ((id >> i) & 1)
+			*lo = mid;
+		else
+			*hi = mid;
+	}
+}
+
+static void spawn(worker_t *w, long id) {
+	__atomic_fetch_add(&pending, 1, __ATOMIC_RELAXED);
+
+	if (w->deque)
+		deque_push(w->deque, (void *)(intptr_t)id);
+	else
+		queue_add(shared, id);
+}
+
+// Returns 1 when this was the last pending task.
+static int run_task(worker_t *w, long id) {
+	long lo, hi, sum = 0;
+
+	task_range(id, &lo, &hi);
+
+	while (hi - lo > cutoff) {
+		spawn(w, 2 * id + 1);
+		id = 2 * id;
+		task_range(id, &lo, &hi);
+	}
+
+	for (long i = lo; i < hi; i++)
+		sum += i;
+
+	w->sum += sum;
+	w->tasks++;
+
+	return __atomic_sub_fetch(&pending, 1, __ATOMIC_ACQ_REL) == 0;
+}
+
+static int steal(worker_t *w, void **item) {
+	for (int i = 0; i < threads; i++) {
+		worker_t *victim = &workers[rand_r(&w->seed) % threads];
+
+		if (victim != w && deque_steal(victim->deque, item) == DEQUE_OK)
+			return 1;
+	}
+
+	return 0;
+}
+
+void *deque_worker(void *arg) {
+	worker_t *w = (worker_t *)arg;
+	void *item;
+
+	place_thread(&place, w->id);
+
+	while (__atomic_load_n(&pending, __ATOMIC_ACQUIRE)) {
+		if (deque_pop(w->deque, &item) || steal(w, &item))
+			run_task(w, (intptr_t)item);
+		else
+			sched_yield();
+	}
+
+	return NULL;
+}
+
+void *queue_worker(void *arg) {
+	worker_t *w = (worker_t *)arg;
+
+	place_thread(&place, w->id);
+
+	while (1) {
+		int id;
+
+		queue_get(shared, &id);
+		if (id == POISON)
+			break;
+
+		// the last one wakes everybody up
+		if (run_task(w, id))
+			for (int i = 0; i < threads; i++)
+				queue_add(shared, POISON);
+	}
+
+	return NULL;
+}
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void run(int use_deque) {
+	long sum = 0, tasks = 0, steals = 0;
+	double start, elapsed;
+	int err;
+
+	workers = calloc(threads, sizeof(worker_t));
+
+	// room for every node of the tree plus the poison, so no add blocks
+	if (!use_deque)
+		shared = queue_init(2 * (n / cutoff + 1) + threads);
+
+	for (int i = 0; i < threads; i++) {
+		workers[i].id = i;
+		workers[i].seed = i + 1;
+		workers[i].deque = use_deque ? deque_init(64) : NULL;
+	}
+
+	start = now();
+
+	spawn(&workers[0], 1);
+
+	for (int i = 0; i < threads; i++) {
+		err = pthread_create(&workers[i].tid, NULL,
+			use_deque ? deque_worker : queue_worker, &workers[i]);
+		if (err) {
+			printf("deque-bench: pthread_create() failed: %s\n", strerror(err));
+			abort();
+		}
+	}
+
+	for (int i = 0; i < threads; i++) {
+		pthread_join(workers[i].tid, NULL);
+		sum += workers[i].sum;
+		tasks += workers[i].tasks;
+	}
+
+	elapsed = now() - start;
+
+	for (int i = 0; i < threads; i++) {
+		if (use_deque) {
+			steals += workers[i].deque->steal_count;
+			deque_destroy(workers[i].deque);
+		}
+	}
+
+	if (!use_deque)
+		queue_destroy(shared);
+
+	printf("%s,%d,%ld,%ld,%.3f,%ld,%ld,%s\n", use_deque ? "deque" : "queue",
+		threads, n, cutoff, elapsed, tasks, steals,
+		sum == n * (n - 1) / 2 ? "ok" : "WRONG");
+	fflush(stdout);
+
+	free(workers);
+}
+
+int main(int argc, char **argv) {
+	char threads_list[256] = "1,2,4,8";
+	int opt, err;
+
+	err = topo_load(&topo);
+	if (err) {
+		printf("deque-bench: topo_load failed: %s\n", strerror(err));
+		return 1;
+	}
+
+	place_init(&place, &topo, PLACE_NONE);
+
+	while ((opt = getopt(argc, argv, "t:n:c:P:")) != -1) {
+		switch (opt) {
+		case 't':
+			snprintf(threads_list, sizeof(threads_list), "%s", optarg);
+			break;
+		case 'n':
+			n = atol(optarg);
+			break;
+		case 'c':
+			cutoff = atol(optarg);
+			break;
+		case 'P':
+			if (place_parse(&place, &topo, optarg)) {
+				printf("deque-bench: bad placement %s\n", optarg);
+				return 1;
+			}
+			break;
+		default:
+			printf("usage: %s [-t threads,...] [-n n] [-c cutoff] [-P placement]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (cutoff < 1 || n / cutoff > INT32_MAX / 4) {
+		printf("deque-bench: too many tasks, raise -c\n");
+		return 1;
+	}
+
+	printf("impl,threads,n,cutoff,seconds,tasks,steals,ok\n");
+
+	for (char *s = strtok(threads_list, ","); s; s = strtok(NULL, ",")) {
+		threads = atoi(s);
+		if (threads < 1) {
+			printf("deque-bench: bad thread count %s\n", s);
+			return 1;
+		}
+
+		run(0);
+		run(1);
+	}
+
+	return 0;
+}
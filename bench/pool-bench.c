@@ -0,0 +1,158 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "pool.h"
+#include "topo.h"
+
+// Task throughput of ../pool against one pthread_create per task. Every
+// task spins for -w iterations. For "thread", up to the thread count
+// tasks run at once: they are created in rounds and joined per round.
+// One CSV line per implementation and thread count:
+//
+//	impl,threads,tasks,work,seconds,tasks_per_sec
+//
+// Pool worker i takes placement slot i. The "thread" threads live for one
+// task each and are left to the scheduler: pinning them would add a
+// syscall per task to what is measured.
+//
+// Usage: pool-bench [-t threads,...] [-n tasks] [-w work] [-q max_tasks] [-P placement]
+
+static long work = 100;
+static long sink;
+
+static topo_t topo;
+static place_t place;
+
+void *task(void *arg) {
+	long x = (intptr_t)arg;
+
+	for (long i = 0; i < work; i++)
+		x = x * 31 + i;
+
+	__atomic_fetch_add(&sink, x & 1, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double run_pool(int threads, long tasks, int max_tasks) {
+	pool_t *p = pool_init(threads, max_tasks);
+	pool_wg_t wg;
+	double start, elapsed;
+
+	for (int i = 0; i < threads; i++)
+		place_tid(&place, p->workers[i], i);
+
+	pool_wg_init(&wg);
+
+	start = now();
+	for (long i = 0; i < tasks; i++)
+		pool_submit(p, task, (void *)(intptr_t)i, NULL, &wg);
+	pool_wg_wait(&wg);
+	elapsed = now() - start;
+
+	pool_wg_destroy(&wg);
+	pool_shutdown(p);
+
+	return elapsed;
+}
+
+static double run_threads(int threads, long tasks) {
+	pthread_t *tids = malloc(threads * sizeof(pthread_t));
+	double start;
+	int err;
+
+	start = now();
+	for (long i = 0; i < tasks; i += threads) {
+		int n = tasks - i < threads ? tasks - i : threads;
+
+		for (int j = 0; j < n; j++) {
+			err = pthread_create(&tids[j], NULL, task, (void *)(intptr_t)(i + j));
+			if (err) {
+				printf("pool-bench: pthread_create() failed: %s\n", strerror(err));
+				abort();
+			}
+		}
+
+		for (int j = 0; j < n; j++)
+			pthread_join(tids[j], NULL);
+	}
+
+	free(tids);
+	return now() - start;
+}
+
+int main(int argc, char **argv) {
+	char threads_list[256] = "1,2,4,8";
+	long tasks = 200000;
+	int max_tasks = 1024;
+	int opt, err;
+
+	err = topo_load(&topo);
+	if (err) {
+		printf("pool-bench: topo_load failed: %s\n", strerror(err));
+		return 1;
+	}
+
+	place_init(&place, &topo, PLACE_NONE);
+
+	while ((opt = getopt(argc, argv, "t:n:w:q:P:")) != -1) {
+		switch (opt) {
+		case 't':
+			snprintf(threads_list, sizeof(threads_list), "%s", optarg);
+			break;
+		case 'n':
+			tasks = atol(optarg);
+			break;
+		case 'w':
+			work = atol(optarg);
+			break;
+		case 'q':
+			max_tasks = atoi(optarg);
+			break;
+		case 'P':
+			if (place_parse(&place, &topo, optarg)) {
+				printf("pool-bench: bad placement %s\n", optarg);
+				return 1;
+			}
+			break;
+		default:
+			printf("usage: %s [-t threads,...] [-n tasks] [-w work] [-q max_tasks] [-P placement]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	printf("impl,threads,tasks,work,seconds,tasks_per_sec\n");
+
+	for (char *s = strtok(threads_list, ","); s; s = strtok(NULL, ",")) {
+		int threads = atoi(s);
+		double elapsed;
+
+		if (threads < 1) {
+			printf("pool-bench: bad thread count %s\n", s);
+			return 1;
+		}
+
+		elapsed = run_pool(threads, tasks, max_tasks);
+		printf("pool,%d,%ld,%ld,%.3f,%.0f\n", threads, tasks, work, elapsed, tasks / elapsed);
+
+		elapsed = run_threads(threads, tasks);
+		printf("thread,%d,%ld,%ld,%.3f,%.0f\n", threads, tasks, work, elapsed, tasks / elapsed);
+
+		fflush(stdout);
+	}
+
+	return 0;
+}
@@ -0,0 +1,296 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "queue.h"
+#include "topo.h"
+
+// Priority queue benchmark: ../prio (lock-striped levels) against one
+// binary heap under one mutex. Every thread adds an item with a random
+// priority and takes one back, on a queue prefilled to half of max_count,
+// for the given time. One CSV line per implementation and thread count:
+//
+//	impl,threads,prios,max_count,duration_s,ops,ops_per_sec
+//
+// Thread i takes placement slot i. -P is the number of priorities here,
+// so the placement goes with -C, the other name queue-bench accepts.
+//
+// Usage: prio-bench [-t threads,...] [-d seconds] [-n max_count] [-P prios] [-C placement]
+
+typedef struct _HeapItem {
+	int prio;
+	int val;
+	long seq;
+} hitem_t;
+
+// Bounded blocking binary heap, the textbook baseline. Ties are broken by
+// insertion order so both implementations are FIFO within a priority.
+typedef struct _Heap {
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+
+	hitem_t *items;
+	int count;
+	int max_count;
+	long seq;
+} heap_t;
+
+static int heap_before(const hitem_t *a, const hitem_t *b) {
+	return a->prio != b->prio ? a->prio > b->prio : a->seq < b->seq;
+}
+
+static heap_t *heap_init(int max_count) {
+	heap_t *h = malloc(sizeof(heap_t));
+
+	h->items = malloc(max_count * sizeof(hitem_t));
+	if (!h->items) {
+		printf("Cannot allocate memory for a heap\n");
+		abort();
+	}
+
+	h->count = 0;
+	h->max_count = max_count;
+	h->seq = 0;
+
+	pthread_mutex_init(&h->lock, NULL);
+	pthread_cond_init(&h->not_empty, NULL);
+	pthread_cond_init(&h->not_full, NULL);
+
+	return h;
+}
+
+static void heap_destroy(heap_t *h) {
+	pthread_mutex_destroy(&h->lock);
+	pthread_cond_destroy(&h->not_empty);
+	pthread_cond_destroy(&h->not_full);
+
+	free(h->items);
+	free(h);
+}
+
+static void heap_add_prio(heap_t *h, int val, int prio) {
+	hitem_t item;
+	int i;
+
+	pthread_mutex_lock(&h->lock);
+
+	while (h->count == h->max_count)
+		pthread_cond_wait(&h->not_full, &h->lock);
+
+	item.prio = prio;
+	item.val = val;
+	item.seq = h->seq++;
+
+	for (i = h->count++; i > 0; i = (i - 1) / 2) {
+		hitem_t *parent = &h->items[(i - 1) / 2];
+
+		if (!heap_before(&item, parent))
+			break;
+		h->items[i] = *parent;
+	}
+	h->items[i] = item;
+
+	pthread_cond_signal(&h->not_empty);
+	pthread_mutex_unlock(&h->lock);
+}
+
+static int heap_get(heap_t *h) {
+	hitem_t last;
+	int val, i;
+
+	pthread_mutex_lock(&h->lock);
+
+	while (h->count == 0)
+		pthread_cond_wait(&h->not_empty, &h->lock);
+
+	val = h->items[0].val;
+	last = h->items[--h->count];
+
+	for (i = 0; ; ) {
+		int child = 2 * i + 1;
+
+		if (child >= h->count)
+			break;
+		if (child + 1 < h->count && heap_before(&h->items[child + 1], &h->items[child]))
+			child++;
+		if (!heap_before(&h->items[child], &last))
+			break;
+
+		h->items[i] = h->items[child];
+		i = child;
+	}
+	h->items[i] = last;
+
+	pthread_cond_signal(&h->not_full);
+	pthread_mutex_unlock(&h->lock);
+
+	return val;
+}
+
+typedef struct _Worker {
+	pthread_t tid;
+	int slot;
+	int use_heap;
+	void *q;
+	unsigned int seed;
+	long ops;
+} worker_t;
+
+static int prios = QUEUE_PRIOS;
+static volatile int stop;
+
+static topo_t topo;
+static place_t place;
+
+void *worker(void *arg) {
+	worker_t *w = (worker_t *)arg;
+	long ops = 0;
+	int val;
+
+	place_thread(&place, w->slot);
+
+	while (!stop) {
+		int prio = rand_r(&w->seed) % prios;
+
+		if (w->use_heap) {
+			heap_add_prio(w->q, ops, prio);
+			heap_get(w->q);
+		} else {
+			queue_add_prio(w->q, ops, prio);
+			queue_get(w->q, &val);
+		}
+
+		ops += 2;
+	}
+
+	w->ops = ops;
+	return NULL;
+}
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void run(int use_heap, int threads, int max_count, double duration) {
+	worker_t *workers = calloc(threads, sizeof(worker_t));
+	void *q = use_heap ? (void *)heap_init(max_count) : (void *)queue_init(max_count);
+	double start, elapsed;
+	long ops = 0;
+	int err;
+
+	for (int i = 0; i < max_count / 2; i++) {
+		if (use_heap)
+			heap_add_prio(q, i, i % prios);
+		else
+			queue_add_prio(q, i, i % prios);
+	}
+
+	stop = 0;
+	start = now();
+
+	for (int i = 0; i < threads; i++) {
+		workers[i].slot = i;
+		workers[i].use_heap = use_heap;
+		workers[i].q = q;
+		workers[i].seed = i + 1;
+
+		err = pthread_create(&workers[i].tid, NULL, worker, &workers[i]);
+		if (err) {
+			printf("prio-bench: pthread_create() failed: %s\n", strerror(err));
+			abort();
+		}
+	}
+
+	usleep(duration * 1e6);
+	stop = 1;
+
+	for (int i = 0; i < threads; i++) {
+		pthread_join(workers[i].tid, NULL);
+		ops += workers[i].ops;
+	}
+
+	elapsed = now() - start;
+
+	printf("%s,%d,%d,%d,%.3f,%ld,%.0f\n", use_heap ? "heap" : "prio",
+		threads, prios, max_count, elapsed, ops, ops / elapsed);
+	fflush(stdout);
+
+	if (use_heap)
+		heap_destroy(q);
+	else
+		queue_destroy(q);
+
+	free(workers);
+}
+
+int main(int argc, char **argv) {
+	char threads_list[256] = "1,2,4,8,16,32";
+	double duration = 1;
+	int max_count = 1000;
+	int opt, err;
+
+	err = topo_load(&topo);
+	if (err) {
+		printf("prio-bench: topo_load failed: %s\n", strerror(err));
+		return 1;
+	}
+
+	place_init(&place, &topo, PLACE_NONE);
+
+	while ((opt = getopt(argc, argv, "t:d:n:P:C:")) != -1) {
+		switch (opt) {
+		case 't':
+			snprintf(threads_list, sizeof(threads_list), "%s", optarg);
+			break;
+		case 'd':
+			duration = atof(optarg);
+			break;
+		case 'n':
+			max_count = atoi(optarg);
+			break;
+		case 'P':
+			prios = atoi(optarg);
+			if (prios < 1 || prios > QUEUE_PRIOS) {
+				printf("prio-bench: -P must be 1..%d\n", QUEUE_PRIOS);
+				return 1;
+			}
+			break;
+		case 'C':
+			if (place_parse(&place, &topo, optarg)) {
+				printf("prio-bench: bad placement %s\n", optarg);
+				return 1;
+			}
+			break;
+		default:
+			printf("usage: %s [-t threads,...] [-d seconds] [-n max_count] [-P prios] [-C placement]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	printf("impl,threads,prios,max_count,duration_s,ops,ops_per_sec\n");
+
+	for (char *s = strtok(threads_list, ","); s; s = strtok(NULL, ",")) {
+		int threads = atoi(s);
+
+		// each thread holds at most one item beyond the prefill
+		if (threads < 1 || max_count / 2 + threads > max_count) {
+			printf("prio-bench: bad thread count %s for max_count %d\n", s, max_count);
+			return 1;
+		}
+
+		run(1, threads, max_count, duration);
+		run(0, threads, max_count, duration);
+	}
+
+	return 0;
+}
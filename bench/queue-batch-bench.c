@@ -0,0 +1,158 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "queue.h"
+#include "topo.h"
+
+#ifndef QUEUE_NAME
+#define QUEUE_NAME "queue"
+#endif
+
+#define RED "\033[41m"
+#define NOCOLOR "\033[0m"
+
+// The writer takes placement slot 0, the reader slot 1.
+//
+// Usage: queue-batch-bench [-P placement] [items] [max_count] [batch]
+
+static long items = 10000000;
+static int batch = 16;
+
+static topo_t topo;
+static place_t place;
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void *reader(void *arg) {
+	queue_t *q = (queue_t *)arg;
+	int *out = malloc(batch * sizeof(int));
+	int expected = 0;
+	long n = 0;
+
+	place_thread(&place, 1);
+
+	while (n < items) {
+		int got = 0;
+		int max = items - n < batch ? items - n : batch;
+
+		queue_get_n(q, out, max, &got);
+
+		for (int i = 0; i < got; i++) {
+			if (expected != out[i])
+				printf(RED"ERROR: get value is %d but expected - %d" NOCOLOR "\n", out[i], expected);
+
+			expected = out[i] + 1;
+		}
+
+		n += got;
+	}
+
+	free(out);
+	return NULL;
+}
+
+void *writer(void *arg) {
+	queue_t *q = (queue_t *)arg;
+	int *vals = malloc(batch * sizeof(int));
+	long i = 0;
+
+	place_thread(&place, 0);
+
+	while (i < items) {
+		int n = items - i < batch ? items - i : batch;
+
+		for (int j = 0; j < n; j++)
+			vals[j] = (int)(i + j);
+
+		// a full queue takes only part of the batch: push the rest
+		for (int done = 0; done < n; )
+			done += queue_add_n(q, vals + done, n - done);
+
+		i += n;
+	}
+
+	free(vals);
+	return NULL;
+}
+
+int main(int argc, char **argv) {
+	pthread_t rtid, wtid;
+	queue_t *q;
+	int max_count = 1000;
+	double start, elapsed;
+	int opt, err;
+
+	err = topo_load(&topo);
+	if (err) {
+		printf("queue-batch-bench: topo_load failed: %s\n", strerror(err));
+		return -1;
+	}
+
+	place_init(&place, &topo, PLACE_NONE);
+
+	while ((opt = getopt(argc, argv, "P:")) != -1) {
+		switch (opt) {
+		case 'P':
+			if (place_parse(&place, &topo, optarg)) {
+				printf("queue-batch-bench: bad placement %s\n", optarg);
+				return -1;
+			}
+			break;
+		default:
+			printf("usage: %s [-P placement] [items] [max_count] [batch]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	if (argc > optind)
+		items = atol(argv[optind]);
+	if (argc > optind + 1)
+		max_count = atoi(argv[optind + 1]);
+	if (argc > optind + 2)
+		batch = atoi(argv[optind + 2]);
+
+	if (items <= 0 || max_count <= 0 || batch <= 0) {
+		printf("usage: %s [-P placement] [items] [max_count] [batch]\n", argv[0]);
+		return -1;
+	}
+
+	q = queue_init(max_count);
+
+	start = now();
+
+	err = pthread_create(&rtid, NULL, reader, q);
+	if (err) {
+		printf("main: pthread_create() failed: %s\n", strerror(err));
+		return -1;
+	}
+
+	err = pthread_create(&wtid, NULL, writer, q);
+	if (err) {
+		printf("main: pthread_create() failed: %s\n", strerror(err));
+		return -1;
+	}
+
+	pthread_join(wtid, NULL);
+	pthread_join(rtid, NULL);
+
+	elapsed = now() - start;
+
+	printf("%s: %ld items, max_count %d, batch %d: %.3f s, %.0f items/sec\n",
+		QUEUE_NAME, items, max_count, batch, elapsed, items / elapsed);
+
+	queue_destroy(q);
+
+	return 0;
+}
@@ -0,0 +1,345 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+
+#include "queue.h"
+#include "topo.h"
+
+// Benchmark driver shared by all queue variants. The Makefile links it
+// against every queue.c in turn; each binary runs producers and consumers
+// for a fixed time and appends one CSV line with the results.
+
+#ifndef QUEUE_NAME
+#define QUEUE_NAME "queue"
+#endif
+
+// QUEUE_SPSC is defined for single-producer single-consumer queues
+// (../spsc), which only run with -p 1 -c 1.
+
+#define MAX_THREADS 256
+#define MAX_SAMPLES (1 << 18)
+
+// value that tells a reader to stop once the writers are done
+#define POISON -1
+
+#define RED "\033[41m"
+#define NOCOLOR "\033[0m"
+
+typedef struct {
+	queue_t *q;
+	int id;
+	int slot;		// placement slot: producers first, then consumers
+
+	long ops;
+
+	// latency of every sample_every-th operation, in ns
+	long *lat;
+	long nlat;
+
+	// reader: last sequence number seen from every producer
+	int *last;
+} worker_t;
+
+static int producers = 1;
+static int consumers = 1;
+static int duration = 5;
+static int max_count = 1000;
+static int sample_every = 64;
+static char *place_arg = NULL;
+static char *csv_path = NULL;
+
+static topo_t topo;
+static place_t place;
+
+static volatile int stop;
+
+static long now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static void record(worker_t *w, long start) {
+	if (w->nlat < MAX_SAMPLES)
+		w->lat[w->nlat++] = now_ns() - start;
+}
+
+void *reader(void *arg) {
+	worker_t *w = (worker_t *)arg;
+
+	place_thread(&place, w->slot);
+
+	for (long n = 0; ; n++) {
+		int sample = n % sample_every == 0;
+		long start = sample ? now_ns() : 0;
+		int val = -1;
+
+		while (!queue_get(w->q, &val))
+			sched_yield();
+
+		if (val == POISON)
+			break;
+
+		if (sample)
+			record(w, start);
+
+		int p = val % producers;
+		int seq = val / producers;
+
+		if (seq <= w->last[p])
+			printf(RED"ERROR: get value %d from producer %d after %d" NOCOLOR "\n", seq, p, w->last[p]);
+
+		w->last[p] = seq;
+		w->ops++;
+	}
+
+	return NULL;
+}
+
+void *writer(void *arg) {
+	worker_t *w = (worker_t *)arg;
+
+	place_thread(&place, w->slot);
+
+	// values must stay positive ints, see POISON
+	for (long i = 0; !stop && i < INT_MAX / producers; i++) {
+		int sample = i % sample_every == 0;
+		long start = sample ? now_ns() : 0;
+
+		while (!queue_add(w->q, (int)(i * producers + w->id))) {
+			if (stop)
+				return NULL;
+			sched_yield();
+		}
+
+		if (sample)
+			record(w, start);
+
+		w->ops++;
+	}
+
+	return NULL;
+}
+
+static int cmp_long(const void *a, const void *b) {
+	long x = *(long *)a;
+	long y = *(long *)b;
+
+	return (x > y) - (x < y);
+}
+
+// p50, p99, p99.9 and max of the samples of all workers
+static void percentiles(worker_t *w, int n, long out[4]) {
+	long total = 0, k = 0;
+	long *all;
+
+	for (int i = 0; i < n; i++)
+		total += w[i].nlat;
+
+	memset(out, 0, 4 * sizeof(long));
+	if (total == 0)
+		return;
+
+	all = malloc(total * sizeof(long));
+	if (!all) {
+		printf("Cannot allocate memory for latency samples\n");
+		abort();
+	}
+
+	for (int i = 0; i < n; i++) {
+		memcpy(all + k, w[i].lat, w[i].nlat * sizeof(long));
+		k += w[i].nlat;
+	}
+
+	qsort(all, total, sizeof(long), cmp_long);
+
+	out[0] = all[total * 50 / 100];
+	out[1] = all[total * 990 / 1000];
+	out[2] = all[total * 999 / 1000];
+	out[3] = all[total - 1];
+
+	free(all);
+}
+
+static double tv_sec(struct timeval tv) {
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void usage(char *prog) {
+	printf("usage: %s [-p producers] [-c consumers] [-d seconds] [-n max_count]\n"
+		"\t[-P none|same|smt|llc|spread|numa|cpu,cpu,...] [-s sample_every] [-o file.csv]\n"
+		"threads are pinned round-robin to the CPUs of the -P placement (none by\n"
+		"default): producers first, then consumers; -C is the same as -P\n",
+		prog);
+}
+
+int main(int argc, char **argv) {
+	worker_t rs[MAX_THREADS], ws[MAX_THREADS];
+	pthread_t rtid[MAX_THREADS], wtid[MAX_THREADS];
+	struct rusage ru_start, ru_end;
+	long start, elapsed, ops = 0;
+	long add_lat[4], get_lat[4];
+	queue_t *q;
+	FILE *out;
+	int opt, err;
+
+	while ((opt = getopt(argc, argv, "p:c:d:n:C:P:s:o:h")) != -1) {
+		switch (opt) {
+		case 'p': producers = atoi(optarg); break;
+		case 'c': consumers = atoi(optarg); break;
+		case 'd': duration = atoi(optarg); break;
+		case 'n': max_count = atoi(optarg); break;
+		case 'C':
+		case 'P': place_arg = optarg; break;
+		case 's': sample_every = atoi(optarg); break;
+		case 'o': csv_path = optarg; break;
+		default:
+			usage(argv[0]);
+			return -1;
+		}
+	}
+
+	err = topo_load(&topo);
+	if (err) {
+		printf("main: topo_load failed: %s\n", strerror(err));
+		return -1;
+	}
+
+	place_init(&place, &topo, PLACE_NONE);
+
+	if (producers <= 0 || producers > MAX_THREADS ||
+	    consumers <= 0 || consumers > MAX_THREADS ||
+	    duration <= 0 || max_count <= 0 || sample_every <= 0 ||
+	    (place_arg && place_parse(&place, &topo, place_arg))) {
+		usage(argv[0]);
+		return -1;
+	}
+
+#ifdef QUEUE_SPSC
+	// the ring has one writer and one reader slot, more would corrupt it
+	if (producers > 1 || consumers > 1) {
+		printf("main: " QUEUE_NAME " takes one producer and one consumer\n");
+		return -1;
+	}
+#endif
+
+	q = queue_init(max_count);
+
+	// only the queue head; nodes are first touched by the threads
+	err = place_mem(&place, q, sizeof(*q));
+	if (err)
+		printf("main: place_mem failed: %s\n", strerror(err));
+
+	for (int i = 0; i < producers + consumers; i++) {
+		worker_t *w = i < producers ? &ws[i] : &rs[i - producers];
+
+		memset(w, 0, sizeof(*w));
+		w->q = q;
+		w->id = i < producers ? i : i - producers;
+		w->slot = i;
+		w->lat = malloc(MAX_SAMPLES * sizeof(long));
+		if (!w->lat) {
+			printf("Cannot allocate memory for latency samples\n");
+			return -1;
+		}
+
+		if (i >= producers) {
+			w->last = malloc(producers * sizeof(int));
+			if (!w->last) {
+				printf("Cannot allocate memory for a reader\n");
+				return -1;
+			}
+			for (int p = 0; p < producers; p++)
+				w->last[p] = -1;
+		}
+	}
+
+	getrusage(RUSAGE_SELF, &ru_start);
+	start = now_ns();
+
+	for (int i = 0; i < consumers; i++) {
+		err = pthread_create(&rtid[i], NULL, reader, &rs[i]);
+		if (err) {
+			printf("main: pthread_create() failed: %s\n", strerror(err));
+			return -1;
+		}
+	}
+
+	for (int i = 0; i < producers; i++) {
+		err = pthread_create(&wtid[i], NULL, writer, &ws[i]);
+		if (err) {
+			printf("main: pthread_create() failed: %s\n", strerror(err));
+			return -1;
+		}
+	}
+
+	sleep(duration);
+	stop = 1;
+
+	for (int i = 0; i < producers; i++)
+		pthread_join(wtid[i], NULL);
+
+	// blocking variants would keep readers asleep in queue_get forever
+	for (int i = 0; i < consumers; i++) {
+		while (!queue_add(q, POISON))
+			sched_yield();
+	}
+
+	for (int i = 0; i < consumers; i++)
+		pthread_join(rtid[i], NULL);
+
+	elapsed = now_ns() - start;
+	getrusage(RUSAGE_SELF, &ru_end);
+
+	for (int i = 0; i < consumers; i++)
+		ops += rs[i].ops;
+
+	percentiles(ws, producers, add_lat);
+	percentiles(rs, consumers, get_lat);
+
+	out = stdout;
+	if (csv_path) {
+		out = fopen(csv_path, "a");
+		if (!out) {
+			printf("main: cannot open %s: %s\n", csv_path, strerror(errno));
+			return -1;
+		}
+		fseek(out, 0, SEEK_END);
+	}
+
+	// header only for a fresh file
+	if (out == stdout || ftell(out) == 0)
+		fprintf(out, "variant,producers,consumers,max_count,placement,duration_s,ops,ops_per_sec,"
+			"add_p50_ns,add_p99_ns,add_p999_ns,add_max_ns,"
+			"get_p50_ns,get_p99_ns,get_p999_ns,get_max_ns,"
+			"vcsw,ivcsw,user_s,sys_s\n");
+
+	fprintf(out, "%s,%d,%d,%d,\"%s\",%.3f,%ld,%.0f,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%.3f,%.3f\n",
+		QUEUE_NAME, producers, consumers, max_count, place_arg ? place_arg : "",
+		elapsed / 1e9, ops, ops / (elapsed / 1e9),
+		add_lat[0], add_lat[1], add_lat[2], add_lat[3],
+		get_lat[0], get_lat[1], get_lat[2], get_lat[3],
+		ru_end.ru_nvcsw - ru_start.ru_nvcsw,
+		ru_end.ru_nivcsw - ru_start.ru_nivcsw,
+		tv_sec(ru_end.ru_utime) - tv_sec(ru_start.ru_utime),
+		tv_sec(ru_end.ru_stime) - tv_sec(ru_start.ru_stime));
+
+	if (out != stdout)
+		fclose(out);
+
+	queue_destroy(q);
+
+	return 0;
+}
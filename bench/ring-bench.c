@@ -0,0 +1,212 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "queue.h"
+#include "ring.h"
+#include "topo.h"
+
+// Broadcast benchmark: one producer sends 0 .. items-1 and every consumer
+// has to see all of them, in order.
+//
+//	ring	../broadcast, all consumers independent
+//	chain	../broadcast, each consumer runs after the previous one
+//	queues	one ../2.2f queue per consumer, the producer adds each item
+//		to every queue (what broadcasting looks like without the ring)
+//
+// One CSV line per implementation and consumer count; items_per_sec counts
+// items published, not deliveries:
+//
+//	impl,consumers,items,size,seconds,items_per_sec,ok
+//
+// The producer takes placement slot 0, consumer i slot i + 1.
+//
+// Usage: ring-bench [-c consumers,...] [-n items] [-s size] [-P placement]
+
+static long items = 10000000;
+static int size = 1024;
+
+static topo_t topo;
+static place_t place;
+
+typedef struct _Consumer {
+	pthread_t tid;
+	int slot;
+	rconsumer_t *c;
+	queue_t *q;
+	int ok;
+} consumer_t;
+
+void *ring_reader(void *arg) {
+	consumer_t *w = (consumer_t *)arg;
+	long expected = 0;
+
+	place_thread(&place, w->slot);
+
+	w->ok = 1;
+	while (expected < items) {
+		long n = ring_wait(w->c);
+
+		for (long i = 0; i < n; i++)
+			if (ring_peek(w->c, i) != expected++)
+				w->ok = 0;
+
+		ring_release(w->c, n);
+	}
+
+	return NULL;
+}
+
+void *queue_reader(void *arg) {
+	consumer_t *w = (consumer_t *)arg;
+
+	place_thread(&place, w->slot);
+
+	w->ok = 1;
+	for (long i = 0; i < items; i++) {
+		int val;
+
+		queue_get(w->q, &val);
+		if (val != i)
+			w->ok = 0;
+	}
+
+	return NULL;
+}
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void start(consumer_t *w, void *(*fn)(void *)) {
+	int err = pthread_create(&w->tid, NULL, fn, w);
+
+	if (err) {
+		printf("ring-bench: pthread_create() failed: %s\n", strerror(err));
+		abort();
+	}
+}
+
+static void run(const char *impl, int consumers) {
+	consumer_t *workers = calloc(consumers, sizeof(consumer_t));
+	int use_queues = !strcmp(impl, "queues");
+	ring_t *r = NULL;
+	double t0, elapsed;
+	int ok = 1;
+
+	if (use_queues) {
+		for (int i = 0; i < consumers; i++)
+			workers[i].q = queue_init(size);
+	} else {
+		r = ring_init(size);
+
+		for (int i = 0; i < consumers; i++) {
+			rconsumer_t *prev = i ? workers[i - 1].c : NULL;
+
+			if (!strcmp(impl, "chain") && prev)
+				workers[i].c = ring_consumer(r, &prev, 1);
+			else
+				workers[i].c = ring_consumer(r, NULL, 0);
+		}
+	}
+
+	t0 = now();
+
+	for (int i = 0; i < consumers; i++) {
+		workers[i].slot = i + 1;
+		start(&workers[i], use_queues ? queue_reader : ring_reader);
+	}
+
+	for (long i = 0; i < items; i++) {
+		if (!use_queues) {
+			ring_add(r, i);
+			continue;
+		}
+
+		for (int j = 0; j < consumers; j++)
+			queue_add(workers[j].q, i);
+	}
+
+	for (int i = 0; i < consumers; i++) {
+		pthread_join(workers[i].tid, NULL);
+		ok &= workers[i].ok;
+	}
+
+	elapsed = now() - t0;
+
+	printf("%s,%d,%ld,%d,%.3f,%.0f,%s\n", impl, consumers, items, size,
+		elapsed, items / elapsed, ok ? "ok" : "WRONG");
+	fflush(stdout);
+
+	if (use_queues) {
+		for (int i = 0; i < consumers; i++)
+			queue_destroy(workers[i].q);
+	} else
+		ring_destroy(r);
+
+	free(workers);
+}
+
+int main(int argc, char **argv) {
+	char consumers_list[256] = "1,2,4,8";
+	int opt, err;
+
+	err = topo_load(&topo);
+	if (err) {
+		printf("ring-bench: topo_load failed: %s\n", strerror(err));
+		return 1;
+	}
+
+	place_init(&place, &topo, PLACE_NONE);
+
+	while ((opt = getopt(argc, argv, "c:n:s:P:")) != -1) {
+		switch (opt) {
+		case 'c':
+			snprintf(consumers_list, sizeof(consumers_list), "%s", optarg);
+			break;
+		case 'n':
+			items = atol(optarg);
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		case 'P':
+			if (place_parse(&place, &topo, optarg)) {
+				printf("ring-bench: bad placement %s\n", optarg);
+				return 1;
+			}
+			break;
+		default:
+			printf("usage: %s [-c consumers,...] [-n items] [-s size] [-P placement]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	place_thread(&place, 0);
+
+	printf("impl,consumers,items,size,seconds,items_per_sec,ok\n");
+
+	for (char *s = strtok(consumers_list, ","); s; s = strtok(NULL, ",")) {
+		int consumers = atoi(s);
+
+		if (consumers < 1 || consumers > RING_MAX_CONSUMERS) {
+			printf("ring-bench: consumers must be 1..%d\n", RING_MAX_CONSUMERS);
+			return 1;
+		}
+
+		run("ring", consumers);
+		run("chain", consumers);
+		run("queues", consumers);
+	}
+
+	return 0;
+}
@@ -0,0 +1,234 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "queue.h"
+#include "topo.h"
+
+// Cross-process throughput: a parent producer sends 0 .. items-1 to a
+// forked consumer through ../shm (anonymous shared mapping), a pipe and a
+// UNIX stream socket pair. Pipe and socket move -b ints per write(2), so
+// -b 1 is the one-message-per-item case and larger values show what
+// batching buys them. One CSV line per transport:
+//
+//	impl,items,batch,max_count,seconds,items_per_sec,ok
+//
+// The producer takes placement slot 0, the consumer process slot 1.
+//
+// Usage: shm-bench [-n items] [-b batch] [-q max_count] [-P placement]
+
+static long items = 2000000;
+static int batch = 1;
+static int max_count = 1000;
+
+static topo_t topo;
+static place_t place;
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int read_full(int fd, void *buf, size_t len) {
+	size_t done = 0;
+
+	while (done < len) {
+		ssize_t n = read(fd, (char *)buf + done, len - done);
+
+		if (n <= 0)
+			return -1;
+		done += n;
+	}
+
+	return 0;
+}
+
+static int write_full(int fd, const void *buf, size_t len) {
+	size_t done = 0;
+
+	while (done < len) {
+		ssize_t n = write(fd, (const char *)buf + done, len - done);
+
+		if (n <= 0)
+			return -1;
+		done += n;
+	}
+
+	return 0;
+}
+
+// Consumer side. Exit status 0 means every value arrived in order.
+static int consume_fd(int fd) {
+	int *buf = malloc(batch * sizeof(int));
+	long expected = 0;
+
+	while (expected < items) {
+		int n = items - expected < batch ? items - expected : batch;
+
+		if (read_full(fd, buf, n * sizeof(int)))
+			return 1;
+
+		for (int i = 0; i < n; i++)
+			if (buf[i] != expected++)
+				return 1;
+	}
+
+	free(buf);
+	return 0;
+}
+
+static void produce_fd(int fd) {
+	int *buf = malloc(batch * sizeof(int));
+
+	for (long i = 0; i < items; ) {
+		int n = items - i < batch ? items - i : batch;
+
+		for (int j = 0; j < n; j++)
+			buf[j] = i + j;
+
+		if (write_full(fd, buf, n * sizeof(int))) {
+			printf("shm-bench: write failed: %s\n", strerror(errno));
+			abort();
+		}
+
+		i += n;
+	}
+
+	free(buf);
+}
+
+static int consume_queue(queue_t *q) {
+	for (long i = 0; i < items; i++) {
+		int val;
+
+		queue_get(q, &val);
+		if (val != i)
+			return 1;
+	}
+
+	return 0;
+}
+
+static void report(const char *impl, int b, double elapsed, int status) {
+	int ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+	printf("%s,%ld,%d,%d,%.3f,%.0f,%s\n", impl, items, b, max_count,
+		elapsed, items / elapsed, ok ? "ok" : "WRONG");
+	fflush(stdout);
+}
+
+static void run_queue(void) {
+	queue_t *q = queue_init(max_count);
+	double start;
+	int status;
+	pid_t pid;
+
+	start = now();
+
+	pid = fork();
+	if (pid == 0) {
+		place_thread(&place, 1);
+		_exit(consume_queue(q));
+	}
+
+	for (long i = 0; i < items; i++)
+		queue_add(q, i);
+
+	waitpid(pid, &status, 0);
+	report("shm", 1, now() - start, status);
+
+	queue_destroy(q);
+}
+
+// pipe or socketpair; fds[0] is read by the child, fds[1] written by us
+static void run_fd(const char *impl, int fds[2]) {
+	double start;
+	int status;
+	pid_t pid;
+
+	start = now();
+
+	pid = fork();
+	if (pid == 0) {
+		place_thread(&place, 1);
+		close(fds[1]);
+		_exit(consume_fd(fds[0]));
+	}
+
+	close(fds[0]);
+	produce_fd(fds[1]);
+	close(fds[1]);
+
+	waitpid(pid, &status, 0);
+	report(impl, batch, now() - start, status);
+}
+
+int main(int argc, char **argv) {
+	int fds[2];
+	int opt, err;
+
+	err = topo_load(&topo);
+	if (err) {
+		printf("shm-bench: topo_load failed: %s\n", strerror(err));
+		return 1;
+	}
+
+	place_init(&place, &topo, PLACE_NONE);
+
+	while ((opt = getopt(argc, argv, "n:b:q:P:")) != -1) {
+		switch (opt) {
+		case 'n':
+			items = atol(optarg);
+			break;
+		case 'b':
+			batch = atoi(optarg);
+			break;
+		case 'q':
+			max_count = atoi(optarg);
+			break;
+		case 'P':
+			if (place_parse(&place, &topo, optarg)) {
+				printf("shm-bench: bad placement %s\n", optarg);
+				return 1;
+			}
+			break;
+		default:
+			printf("usage: %s [-n items] [-b batch] [-q max_count] [-P placement]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (batch < 1) {
+		printf("shm-bench: batch must be positive\n");
+		return 1;
+	}
+
+	place_thread(&place, 0);
+
+	printf("impl,items,batch,max_count,seconds,items_per_sec,ok\n");
+
+	run_queue();
+
+	if (pipe(fds)) {
+		printf("shm-bench: pipe failed: %s\n", strerror(errno));
+		return 1;
+	}
+	run_fd("pipe", fds);
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+		printf("shm-bench: socketpair failed: %s\n", strerror(errno));
+		return 1;
+	}
+	run_fd("socket", fds);
+
+	return 0;
+}
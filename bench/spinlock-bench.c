@@ -0,0 +1,248 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "spinlock.h"
+#include "topo.h"
+
+// How waiting on ../2.4/spinlock slows down the thread that holds it.
+// Every thread takes the lock, updates -w longs of the data it protects
+// (the first ones share the lock's cache line, as in the queues) and lets
+// it go, then works -o iterations outside. The holder times each critical
+// section; waiters that hammer the lock line make those sections longer.
+//
+//	tas	the old spinlock_lock: a locked exchange on every iteration
+//	ttas	spinlock_lock without backoff: spin reading, then exchange
+//	backoff	spinlock_lock with the default randomized backoff
+//
+// One CSV line per lock and thread count:
+//
+//	lock,threads,seconds,acquires_per_sec,cs_mean_ns,cs_p50_ns,cs_p99_ns,cs_max_ns,contended_pct,spins_per_acquire
+//
+// Thread i takes placement slot i.
+//
+// Usage: spinlock-bench [-t threads,...] [-d seconds] [-w cs_work] [-o outside_work] [-P placement]
+
+#define MAX_THREADS 256
+#define MAX_SAMPLES (1 << 16)
+#define DATA_LONGS 64
+
+typedef struct {
+	spinlock_t lock;
+	long data[DATA_LONGS];
+} __attribute__((aligned(CACHE_LINE_SIZE))) shared_t;
+
+typedef struct {
+	pthread_t tid;
+	int slot;
+	long acquires;
+	long cs_ns;
+	long *samples;
+	long nsamples;
+} worker_t;
+
+static shared_t shared;
+static void (*lock_fn)(spinlock_t *lock);
+
+static int duration = 2;
+static int cs_work = 16;
+static int outside_work = 100;
+static long sink;
+
+static volatile int stop;
+
+static topo_t topo;
+static place_t place;
+
+static long now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// The spinlock_lock this directory started with, counted the same way
+static void tas_lock(spinlock_t *lock) {
+	long spins = 0;
+
+	while (__sync_val_compare_and_swap(&lock->lock, 0, 1) != 0)
+		spins++;
+
+	lock->acquires++;
+	if (spins) {
+		lock->contended++;
+		lock->spins += spins;
+	}
+}
+
+void *worker(void *arg) {
+	worker_t *w = (worker_t *)arg;
+	long x = 0;
+
+	place_thread(&place, w->slot);
+
+	while (!stop) {
+		long start, cs;
+
+		lock_fn(&shared.lock);
+
+		start = now_ns();
+		for (int i = 0; i < cs_work; i++)
+			shared.data[i % DATA_LONGS]++;
+		cs = now_ns() - start;
+
+		spinlock_unlock(&shared.lock);
+
+		w->acquires++;
+		w->cs_ns += cs;
+		if (w->nsamples < MAX_SAMPLES)
+			w->samples[w->nsamples++] = cs;
+
+		for (int i = 0; i < outside_work; i++)
+			x = x * 31 + i;
+	}
+
+	__atomic_fetch_add(&sink, x & 1, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+static int cmp_long(const void *a, const void *b) {
+	long x = *(long *)a;
+	long y = *(long *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void run(const char *name, int threads) {
+	static worker_t ws[MAX_THREADS];
+	long acquires = 0, cs_ns = 0, total = 0, k = 0;
+	long start, elapsed;
+	long *all;
+	int err;
+
+	spinlock_init(&shared.lock);
+	if (strcmp(name, "ttas") == 0)
+		spinlock_set_backoff(&shared.lock, 0, 0);
+
+	lock_fn = strcmp(name, "tas") == 0 ? tas_lock : spinlock_lock;
+	stop = 0;
+
+	for (int i = 0; i < threads; i++) {
+		ws[i].slot = i;
+		ws[i].acquires = ws[i].cs_ns = ws[i].nsamples = 0;
+		ws[i].samples = malloc(MAX_SAMPLES * sizeof(long));
+		if (!ws[i].samples) {
+			printf("Cannot allocate memory for samples\n");
+			abort();
+		}
+	}
+
+	start = now_ns();
+
+	for (int i = 0; i < threads; i++) {
+		err = pthread_create(&ws[i].tid, NULL, worker, &ws[i]);
+		if (err) {
+			printf("spinlock-bench: pthread_create() failed: %s\n", strerror(err));
+			abort();
+		}
+	}
+
+	sleep(duration);
+	stop = 1;
+
+	for (int i = 0; i < threads; i++) {
+		pthread_join(ws[i].tid, NULL);
+		acquires += ws[i].acquires;
+		cs_ns += ws[i].cs_ns;
+		total += ws[i].nsamples;
+	}
+
+	elapsed = now_ns() - start;
+
+	all = malloc(total * sizeof(long));
+	if (!all) {
+		printf("Cannot allocate memory for samples\n");
+		abort();
+	}
+
+	for (int i = 0; i < threads; i++) {
+		memcpy(all + k, ws[i].samples, ws[i].nsamples * sizeof(long));
+		k += ws[i].nsamples;
+		free(ws[i].samples);
+	}
+
+	qsort(all, total, sizeof(long), cmp_long);
+
+	printf("%s,%d,%.3f,%.0f,%.1f,%ld,%ld,%ld,%.3f,%.1f\n", name, threads, elapsed / 1e9,
+		acquires / (elapsed / 1e9), (double)cs_ns / acquires,
+		all[total * 50 / 100], all[total * 99 / 100], all[total - 1],
+		100.0 * shared.lock.contended / shared.lock.acquires,
+		(double)shared.lock.spins / shared.lock.acquires);
+	fflush(stdout);
+
+	free(all);
+}
+
+int main(int argc, char **argv) {
+	char threads_list[256] = "1,2,4,8,16,32,64";
+	const char *locks[] = { "tas", "ttas", "backoff" };
+	int opt, err;
+
+	err = topo_load(&topo);
+	if (err) {
+		printf("spinlock-bench: topo_load failed: %s\n", strerror(err));
+		return 1;
+	}
+
+	place_init(&place, &topo, PLACE_NONE);
+
+	while ((opt = getopt(argc, argv, "t:d:w:o:P:")) != -1) {
+		switch (opt) {
+		case 't':
+			snprintf(threads_list, sizeof(threads_list), "%s", optarg);
+			break;
+		case 'd':
+			duration = atoi(optarg);
+			break;
+		case 'w':
+			cs_work = atoi(optarg);
+			break;
+		case 'o':
+			outside_work = atoi(optarg);
+			break;
+		case 'P':
+			if (place_parse(&place, &topo, optarg)) {
+				printf("spinlock-bench: bad placement %s\n", optarg);
+				return 1;
+			}
+			break;
+		default:
+			printf("usage: %s [-t threads,...] [-d seconds] [-w cs_work] [-o outside_work] [-P placement]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	printf("lock,threads,seconds,acquires_per_sec,cs_mean_ns,cs_p50_ns,cs_p99_ns,cs_max_ns,contended_pct,spins_per_acquire\n");
+
+	for (char *s = strtok(threads_list, ","); s; s = strtok(NULL, ",")) {
+		int threads = atoi(s);
+
+		if (threads < 1 || threads > MAX_THREADS) {
+			printf("spinlock-bench: bad thread count %s\n", s);
+			return 1;
+		}
+
+		for (int i = 0; i < 3; i++)
+			run(locks[i], threads);
+	}
+
+	return 0;
+}
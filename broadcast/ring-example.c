@@ -0,0 +1,115 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "ring.h"
+
+#define RED "\033[41m"
+#define NOCOLOR "\033[0m"
+
+#define ITEMS 20000000
+#define BATCH 64
+
+// A diamond: "order" and "square" both see every item, "join" runs after
+// both of them and checks that it sees what "square" wrote for the same
+// sequence, without any lock between them.
+//
+//	writer --> order ----+
+//	       +-> square ---+--> join
+
+static long *squares;
+
+typedef struct _Stage {
+	const char *name;
+	rconsumer_t *c;
+	void (*handle)(int val);
+	pthread_t tid;
+} stage_t;
+
+static void check_order(int val) {
+	static int expected;
+
+	if (val != expected)
+		printf(RED"ERROR: order: got %d but expected %d" NOCOLOR "\n", val, expected);
+	expected = val + 1;
+}
+
+static void square(int val) {
+	squares[val] = (long)val * val;
+}
+
+static void join(int val) {
+	if (squares[val] != (long)val * val)
+		printf(RED"ERROR: join: item %d is not squared yet" NOCOLOR "\n", val);
+}
+
+void *consumer(void *arg) {
+	stage_t *s = (stage_t *)arg;
+	long done = 0;
+
+	printf("%s [%d %d %d]\n", s->name, getpid(), getppid(), gettid());
+
+	while (done < ITEMS) {
+		long n = ring_wait(s->c);
+
+		for (long i = 0; i < n; i++)
+			s->handle(ring_peek(s->c, i));
+
+		ring_release(s->c, n);
+		done += n;
+	}
+
+	return NULL;
+}
+
+int main() {
+	stage_t stages[3] = {
+		{ "order", NULL, check_order },
+		{ "square", NULL, square },
+		{ "join", NULL, join },
+	};
+	rconsumer_t *before_join[2];
+	int vals[BATCH];
+	ring_t *r;
+	int err;
+
+	printf("main [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	squares = calloc(ITEMS, sizeof(long));
+	r = ring_init(4096);
+
+	stages[0].c = ring_consumer(r, NULL, 0);
+	stages[1].c = ring_consumer(r, NULL, 0);
+	before_join[0] = stages[0].c;
+	before_join[1] = stages[1].c;
+	stages[2].c = ring_consumer(r, before_join, 2);
+
+	for (int i = 0; i < 3; i++) {
+		err = pthread_create(&stages[i].tid, NULL, consumer, &stages[i]);
+		if (err) {
+			printf("main: pthread_create() failed: %s\n", strerror(err));
+			return -1;
+		}
+	}
+
+	for (int i = 0; i < ITEMS; i += BATCH) {
+		for (int j = 0; j < BATCH; j++)
+			vals[j] = i + j;
+		ring_add_n(r, vals, BATCH);
+	}
+
+	for (int i = 0; i < 3; i++)
+		pthread_join(stages[i].tid, NULL);
+
+	ring_print_stats(r);
+
+	ring_destroy(r);
+	free(squares);
+
+	return 0;
+}
@@ -0,0 +1,224 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <assert.h>
+
+#include "ring.h"
+
+#define LOAD_RELAXED(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define LOAD_ACQUIRE(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#else
+	__asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+// Waiting strategy of both sides: poll for a while, then give the CPU
+// away between polls.
+static inline void ring_pause(int *spins) {
+	if (++*spins < RING_SPINS)
+		cpu_relax();
+	else
+		sched_yield();
+}
+
+static unsigned long ring_size(int size) {
+	unsigned long n = 1;
+
+	while (n < (unsigned long)size)
+		n <<= 1;
+
+	return n;
+}
+
+ring_t *ring_init(int size) {
+	ring_t *r;
+	int err;
+
+	assert(size > 0);
+
+	err = posix_memalign((void **)&r, CACHE_LINE_SIZE, sizeof(ring_t));
+	if (err) {
+		printf("Cannot allocate memory for a ring\n");
+		abort();
+	}
+
+	r->mask = ring_size(size) - 1;
+	r->size = r->mask + 1;
+
+	r->buf = malloc(r->size * sizeof(int));
+	if (!r->buf) {
+		printf("Cannot allocate memory for a ring buffer\n");
+		free(r);
+		abort();
+	}
+
+	r->next = r->gate = 0;
+	r->cursor.value = 0;
+	r->waits = 0;
+	r->nconsumers = 0;
+
+	return r;
+}
+
+void ring_destroy(ring_t *r) {
+	if (r == NULL) return;
+
+	for (int i = 0; i < r->nconsumers; i++)
+		free(r->consumers[i]);
+
+	free(r->buf);
+	free(r);
+}
+
+rconsumer_t *ring_consumer(ring_t *r, rconsumer_t **after, int nafter) {
+	rconsumer_t *c;
+
+	if (r->nconsumers == RING_MAX_CONSUMERS) {
+		printf("ring_consumer: more than %d consumers\n", RING_MAX_CONSUMERS);
+		abort();
+	}
+
+	if (posix_memalign((void **)&c, CACHE_LINE_SIZE, sizeof(rconsumer_t))) {
+		printf("Cannot allocate memory for a ring consumer\n");
+		abort();
+	}
+
+	c->ring = r;
+	c->seq.value = r->cursor.value;
+	c->avail = c->seq.value;
+	c->gating = 1;
+	c->waits = 0;
+
+	// the consumers before c cannot be past the cursor, so they are all
+	// the barrier needs; and the producer only has to wait for the ends
+	// of the chains
+	c->ndeps = 0;
+	for (int i = 0; i < nafter; i++) {
+		assert(after[i]->ring == r);
+		c->deps[c->ndeps++] = &after[i]->seq;
+		after[i]->gating = 0;
+	}
+	if (!c->ndeps)
+		c->deps[c->ndeps++] = &r->cursor;
+
+	r->consumers[r->nconsumers++] = c;
+
+	return c;
+}
+
+// Lowest sequence a gating consumer still needs.
+static unsigned long ring_min_gating(ring_t *r) {
+	unsigned long min = LOAD_RELAXED(&r->next);
+
+	for (int i = 0; i < r->nconsumers; i++) {
+		rconsumer_t *c = r->consumers[i];
+		unsigned long seq;
+
+		if (!c->gating)
+			continue;
+
+		seq = LOAD_ACQUIRE(&c->seq.value);
+		if (seq < min)
+			min = seq;
+	}
+
+	return min;
+}
+
+void ring_add_n(ring_t *r, const int *vals, int n) {
+	unsigned long next = r->next;
+	unsigned long end = next + n;
+	int spins = 0;
+
+	assert(n > 0 && n <= r->size);
+
+	// Only look at the consumers when the cached gate says the claim would
+	// lap one of them.
+	while (end - r->gate > (unsigned long)r->size) {
+		r->gate = ring_min_gating(r);
+		if (end - r->gate <= (unsigned long)r->size)
+			break;
+
+		r->waits++;
+		ring_pause(&spins);
+	}
+
+	for (int i = 0; i < n; i++)
+		r->buf[(next + i) & r->mask] = vals[i];
+
+	r->next = end;
+	STORE_RELEASE(&r->cursor.value, end);
+}
+
+void ring_add(ring_t *r, int val) {
+	ring_add_n(r, &val, 1);
+}
+
+static unsigned long ring_barrier(rconsumer_t *c) {
+	unsigned long min = LOAD_ACQUIRE(&c->deps[0]->value);
+
+	for (int i = 1; i < c->ndeps; i++) {
+		unsigned long seq = LOAD_ACQUIRE(&c->deps[i]->value);
+
+		if (seq < min)
+			min = seq;
+	}
+
+	return min;
+}
+
+long ring_wait(rconsumer_t *c) {
+	unsigned long seq = c->seq.value;
+	int spins = 0;
+
+	while (c->avail == seq) {
+		c->avail = ring_barrier(c);
+		if (c->avail != seq)
+			break;
+
+		c->waits++;
+		ring_pause(&spins);
+	}
+
+	return c->avail - seq;
+}
+
+int ring_peek(rconsumer_t *c, long i) {
+	return c->ring->buf[(c->seq.value + i) & c->ring->mask];
+}
+
+void ring_release(rconsumer_t *c, long n) {
+	assert(c->seq.value + n <= c->avail);
+
+	STORE_RELEASE(&c->seq.value, c->seq.value + n);
+}
+
+int ring_get(rconsumer_t *c) {
+	int val;
+
+	ring_wait(c);
+	val = ring_peek(c, 0);
+	ring_release(c, 1);
+
+	return val;
+}
+
+void ring_print_stats(ring_t *r) {
+	printf("ring stats: size %d; published %lu; producer waits %ld\n",
+		r->size, LOAD_ACQUIRE(&r->cursor.value), r->waits);
+
+	for (int i = 0; i < r->nconsumers; i++) {
+		rconsumer_t *c = r->consumers[i];
+
+		printf("  consumer %d: seq %lu; lag %lu; waits %ld%s\n", i,
+			LOAD_ACQUIRE(&c->seq.value),
+			LOAD_ACQUIRE(&r->cursor.value) - LOAD_ACQUIRE(&c->seq.value),
+			c->waits, c->gating ? "; gating" : "");
+	}
+}
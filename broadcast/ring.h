@@ -0,0 +1,87 @@
+#ifndef __FITOS_RING_H__
+#define __FITOS_RING_H__
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define CACHE_LINE_SIZE 64
+
+#define RING_MAX_CONSUMERS 16
+// busy polls before a waiting side starts calling sched_yield
+#define RING_SPINS 128
+
+// A sequence on a cache line of its own, written by one thread only.
+typedef struct _RingSeq {
+	unsigned long value;
+} __attribute__((aligned(CACHE_LINE_SIZE))) rseq_t;
+
+struct _Ring;
+
+// One reader of the ring. seq is the next sequence it will read: all
+// slots below it are done with. The barrier is the list of sequences the
+// consumer may not overtake - the producer cursor, or the consumers it
+// was declared to run after.
+typedef struct _RingConsumer {
+	rseq_t seq;
+
+	const rseq_t *deps[RING_MAX_CONSUMERS];
+	int ndeps;
+	unsigned long avail;	// last barrier value seen
+
+	int gating;		// nobody runs after it, the producer waits for it
+	long waits;		// times the barrier had to be polled again
+	struct _Ring *ring;
+} rconsumer_t;
+
+// Single-producer broadcast ring (LMAX Disruptor). Every consumer sees
+// every item; nothing is copied and nothing is locked. Sequences only grow,
+// slot = sequence & mask. The producer may not lap the slowest gating
+// consumer, a consumer may not pass its barrier.
+typedef struct _Ring {
+	// producer side
+	unsigned long next __attribute__((aligned(CACHE_LINE_SIZE)));
+	unsigned long gate;	// last minimum of the gating consumers seen
+	long waits;
+
+	// everything below cursor is published
+	rseq_t cursor;
+
+	// read-only once consumers are set up
+	int *buf __attribute__((aligned(CACHE_LINE_SIZE)));
+	unsigned long mask;
+	int size;
+
+	rconsumer_t *consumers[RING_MAX_CONSUMERS];
+	int nconsumers;
+} ring_t;
+
+// size is rounded up to a power of 2.
+ring_t *ring_init(int size);
+void ring_destroy(ring_t *r);
+
+// Adds a consumer that only sees an item after all of after[0..nafter-1]
+// are done with it (nafter 0: as soon as it is published). Consumers are
+// set up before the producer starts; they start at the current cursor.
+rconsumer_t *ring_consumer(ring_t *r, rconsumer_t **after, int nafter);
+
+// producer only; n must not exceed the ring size
+void ring_add(ring_t *r, int val);
+void ring_add_n(ring_t *r, const int *vals, int n);
+
+// Consumer side, batch style: ring_wait blocks until something is past
+// the barrier and returns how many items are; ring_peek(c, i) reads the
+// i-th of them and ring_release(c, n) hands the first n on to the
+// consumers after c and to the producer.
+long ring_wait(rconsumer_t *c);
+int ring_peek(rconsumer_t *c, long i);
+void ring_release(rconsumer_t *c, long n);
+
+// one item: ring_wait, ring_peek(c, 0), ring_release(c, 1)
+int ring_get(rconsumer_t *c);
+
+void ring_print_stats(ring_t *r);
+
+#endif		// __FITOS_RING_H__
@@ -0,0 +1,108 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "queue.h"
+#include "topo.h"
+
+#define RED "\033[41m"
+#define NOCOLOR "\033[0m"
+
+#define WRITERS 8
+
+typedef struct _Writer {
+	queue_t *q;
+	int id;
+} writer_t;
+
+// Values are seq * WRITERS + writer id. Combining may interleave writers in
+// any way, but every writer's own sequence must come out in order.
+void *reader(void *arg) {
+	int expected[WRITERS] = { 0 };
+	long got = 0;
+	queue_t *q = (queue_t *)arg;
+	printf("reader [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	place_self(0);
+
+	while (1) {
+		int val = -1;
+		int ok = queue_get(q, &val);
+		if (!ok)
+			continue;
+
+		int id = val % WRITERS, seq = val / WRITERS;
+
+		if (expected[id] != seq)
+			printf(RED"ERROR: writer %d: get seq %d but expected - %d" NOCOLOR "\n", id, seq, expected[id]);
+
+		expected[id] = seq + 1;
+
+		if (++got % 10000000 == 0)
+			queue_print_stats(q);
+	}
+
+	return NULL;
+}
+
+void *writer(void *arg) {
+	writer_t *w = (writer_t *)arg;
+	int i = 0;
+	printf("writer %d [%d %d %d]\n", w->id, getpid(), getppid(), gettid());
+
+	// slot 0 is the reader
+	place_self(1 + w->id);
+
+	while (1) {
+		int ok = queue_add(w->q, i * WRITERS + w->id);
+		if (!ok)
+			continue;
+		i++;
+	}
+
+	return NULL;
+}
+
+int main() {
+	writer_t writers[WRITERS];
+	pthread_t tid;
+	queue_t *q;
+	int err;
+
+	printf("main [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	q = queue_init(1000000);
+
+	err = pthread_create(&tid, NULL, reader, q);
+	if (err) {
+		printf("main: pthread_create() failed: %s\n", strerror(err));
+		return -1;
+	}
+
+	sched_yield();
+
+	for (int i = 0; i < WRITERS; i++) {
+		writers[i].q = q;
+		writers[i].id = i;
+
+		err = pthread_create(&tid, NULL, writer, &writers[i]);
+		if (err) {
+			printf("main: pthread_create() failed: %s\n", strerror(err));
+			return -1;
+		}
+	}
+
+	// TODO: join threads
+
+	pthread_exit(NULL);
+
+	return 0;
+}
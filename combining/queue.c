@@ -0,0 +1,266 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <assert.h>
+
+#include "queue.h"
+
+#define LOAD_RELAXED(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define LOAD_ACQUIRE(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define STORE_RELAXED(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELAXED)
+#define STORE_RELEASE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#else
+	__asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+static void queue_slot_release(void *arg) {
+	qslot_t *slot = (qslot_t *)arg;
+
+	STORE_RELEASE(&slot->used, 0);
+}
+
+queue_t* queue_init(int max_count) {
+    int err;
+    queue_t *q;
+
+    err = posix_memalign((void **)&q, CACHE_LINE_SIZE, sizeof(queue_t));
+    if (err) {
+        printf("Cannot allocate memory for a queue\n");
+        abort();
+    }
+
+    q->first = NULL;
+    q->last = NULL;
+    q->max_count = max_count;
+    q->count = 0;
+
+    q->add_attempts = q->get_attempts = 0;
+    q->add_count = q->get_count = 0;
+    q->combines = q->combined = 0;
+
+    q->lock = 0;
+    q->slots = NULL;
+
+    err = pthread_key_create(&q->slot_key, queue_slot_release);
+    if (err) {
+        printf("queue_init: pthread_key_create failed: %s\n", strerror(err));
+        free(q);
+        abort();
+    }
+
+    return q;
+}
+
+void queue_destroy(queue_t *q) {
+    if (q == NULL) return;
+
+    pthread_key_delete(q->slot_key);
+
+    while (q->slots) {
+        qslot_t *slot = q->slots;
+        q->slots = slot->next;
+        free(slot);
+    }
+
+    qnode_t *current = q->first;
+    while (current != NULL) {
+        qnode_t *temp = current;
+        current = current->next;
+        free(temp);
+    }
+
+    free(q);
+}
+
+// Slot of the calling thread: a free one left by an exited thread, or a
+// new one pushed to the front of the list.
+static qslot_t *queue_slot(queue_t *q) {
+	qslot_t *slot = pthread_getspecific(q->slot_key);
+	int err;
+
+	if (slot)
+		return slot;
+
+	for (slot = LOAD_ACQUIRE(&q->slots); slot; slot = slot->next) {
+		int unused = 0;
+
+		if (__atomic_compare_exchange_n(&slot->used, &unused, 1, 0,
+				__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			break;
+	}
+
+	if (!slot) {
+		err = posix_memalign((void **)&slot, CACHE_LINE_SIZE, sizeof(qslot_t));
+		if (err) {
+			printf("Cannot allocate memory for a queue slot\n");
+			abort();
+		}
+
+		slot->req = QREQ_NONE;
+		slot->used = 1;
+		slot->next = LOAD_RELAXED(&q->slots);
+
+		while (!__atomic_compare_exchange_n(&q->slots, &slot->next, slot, 0,
+				__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+			;
+	}
+
+	pthread_setspecific(q->slot_key, slot);
+	return slot;
+}
+
+// The sequential queue. Only the combiner gets here, and nodes are
+// allocated and freed by the threads that asked, so a combining pass is
+// nothing but pointer writes.
+static void queue_do_add(queue_t *q, qslot_t *slot) {
+	qnode_t *new = slot->node;
+
+	q->add_attempts++;
+	assert(q->count <= q->max_count);
+
+	if (q->count == q->max_count) {
+		slot->ret = 0;
+		return;
+	}
+
+	new->next = NULL;
+
+	if (!q->first)
+		q->first = q->last = new;
+	else {
+		q->last->next = new;
+		q->last = new;
+	}
+
+	q->count++;
+	q->add_count++;
+	slot->ret = 1;
+}
+
+static void queue_do_get(queue_t *q, qslot_t *slot) {
+	q->get_attempts++;
+
+	if (q->count == 0) {
+		slot->ret = 0;
+		return;
+	}
+
+	slot->node = q->first;
+	q->first = q->first->next;
+	if (!q->first)
+		q->last = NULL;
+
+	q->count--;
+	q->get_count++;
+	slot->ret = 1;
+}
+
+// Runs published requests until a pass finds none or QUEUE_COMBINE_PASSES
+// are done, so one combiner cannot be kept busy forever.
+static void queue_combine(queue_t *q) {
+	q->combines++;
+
+	for (int pass = 0; pass < QUEUE_COMBINE_PASSES; pass++) {
+		long done = 0;
+
+		for (qslot_t *slot = LOAD_ACQUIRE(&q->slots); slot; slot = slot->next) {
+			int req = LOAD_ACQUIRE(&slot->req);
+
+			if (req == QREQ_ADD)
+				queue_do_add(q, slot);
+			else if (req == QREQ_GET)
+				queue_do_get(q, slot);
+			else
+				continue;
+
+			STORE_RELEASE(&slot->req, QREQ_DONE);
+			done++;
+		}
+
+		q->combined += done;
+		if (!done)
+			break;
+	}
+}
+
+// Publishes req and waits until some combiner, maybe this thread, has
+// run it. Returns the result; for a get slot->node holds the node.
+static int queue_request(queue_t *q, qslot_t *slot, int req) {
+	int spins = 0;
+
+	STORE_RELEASE(&slot->req, req);
+
+	while (1) {
+		if (!LOAD_RELAXED(&q->lock) && !__atomic_exchange_n(&q->lock, 1, __ATOMIC_ACQUIRE)) {
+			queue_combine(q);
+			STORE_RELEASE(&q->lock, 0);
+		}
+
+		if (LOAD_ACQUIRE(&slot->req) == QREQ_DONE)
+			break;
+
+		// somebody else is combining, wait for it on our own slot
+		while (LOAD_RELAXED(&q->lock) && LOAD_ACQUIRE(&slot->req) != QREQ_DONE) {
+			if (++spins < QUEUE_SPINS)
+				cpu_relax();
+			else
+				sched_yield();
+		}
+
+		if (LOAD_ACQUIRE(&slot->req) == QREQ_DONE)
+			break;
+	}
+
+	STORE_RELAXED(&slot->req, QREQ_NONE);
+	return slot->ret;
+}
+
+int queue_add(queue_t *q, int val) {
+	qslot_t *slot = queue_slot(q);
+	qnode_t *new = malloc(sizeof(qnode_t));
+	if (!new) {
+		printf("Cannot allocate memory for new node\n");
+		abort();
+	}
+
+	new->val = val;
+	slot->node = new;
+
+	if (!queue_request(q, slot, QREQ_ADD)) {
+		free(new);
+		return 0;
+	}
+
+	return 1;
+}
+
+int queue_get(queue_t *q, int *val) {
+	qslot_t *slot = queue_slot(q);
+	qnode_t *tmp;
+
+	if (!queue_request(q, slot, QREQ_GET))
+		return 0;
+
+	tmp = slot->node;
+	*val = tmp->val;
+	free(tmp);
+	return 1;
+}
+
+void queue_print_stats(queue_t *q) {
+	long combines = LOAD_RELAXED(&q->combines);
+	long combined = LOAD_RELAXED(&q->combined);
+
+	printf("queue stats: current size %d; attempts: (%ld %ld %ld); counts (%ld %ld %ld); %.2f requests per combine\n",
+		q->count,
+		q->add_attempts, q->get_attempts, q->add_attempts - q->get_attempts,
+		q->add_count, q->get_count, q->add_count - q->get_count,
+		combines ? (double)combined / combines : 0.0);
+}
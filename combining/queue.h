@@ -0,0 +1,76 @@
+#ifndef __FITOS_QUEUE_H__
+#define __FITOS_QUEUE_H__
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define CACHE_LINE_SIZE 64
+
+// Passes over the slots a combiner makes before it lets the lock go
+#define QUEUE_COMBINE_PASSES 3
+// Polls of its own slot a waiting thread makes before it starts yielding
+#define QUEUE_SPINS 100
+
+// State of a request in a slot
+#define QREQ_NONE 0
+#define QREQ_ADD 1
+#define QREQ_GET 2
+#define QREQ_DONE 3
+
+typedef struct _QueueNode {
+	int val;
+	struct _QueueNode *next;
+} qnode_t;
+
+// Publication slot of one thread. The owner fills in node and sets req,
+// the combiner applies it, writes ret (and node for a get) and sets req
+// to QREQ_DONE. A slot whose thread exited is reused by the next new one.
+typedef struct _QueueSlot {
+	int req;
+	int ret;
+	qnode_t *node;
+
+	int used;
+	struct _QueueSlot *next;
+} __attribute__((aligned(CACHE_LINE_SIZE))) qslot_t;
+
+// Flat-combining queue. Threads do not take turns on the lock: each one
+// publishes its add or get in its own slot, and whichever thread gets the
+// lock runs all published requests in one go. The list and the counters
+// stay in the combiner's cache while the others spin on their own slot.
+// add and get return 0 on full and empty, like 2.2e.
+typedef struct _Queue {
+	// written by the combiner only
+	qnode_t *first __attribute__((aligned(CACHE_LINE_SIZE)));
+	qnode_t *last;
+	int count;
+	int max_count;
+
+	long add_attempts;
+	long get_attempts;
+	long add_count;
+	long get_count;
+
+	long combines;		// times the lock was taken
+	long combined;		// requests run, combined / combines is the batch
+
+	int lock __attribute__((aligned(CACHE_LINE_SIZE)));
+
+	// slots are only ever pushed, so the combiner walks them without a lock
+	qslot_t *slots __attribute__((aligned(CACHE_LINE_SIZE)));
+	pthread_key_t slot_key;
+} queue_t;
+
+queue_t* queue_init(int max_count);
+void queue_destroy(queue_t *q);
+int queue_add(queue_t *q, int val);
+int queue_get(queue_t *q, int *val);
+void queue_print_stats(queue_t *q);
+
+#endif		// __FITOS_QUEUE_H__
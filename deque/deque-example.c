@@ -0,0 +1,38 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "deque.h"
+
+int main() {
+	deque_t *d;
+	void *item;
+
+	printf("main: [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	// small on purpose, the pushes below make it grow
+	d = deque_init(4);
+
+	for (intptr_t i = 0; i < 10; i++) {
+		deque_push(d, (void *)i);
+		printf("push %ld: size %ld\n", i, deque_size(d));
+	}
+
+	// a thief takes the oldest items...
+	for (int i = 0; i < 3; i++) {
+		int ret = deque_steal(d, &item);
+		printf("steal %d: %ld\n", ret, (intptr_t)item);
+	}
+
+	// ...the owner the newest
+	while (deque_pop(d, &item))
+		printf("pop: %ld\n", (intptr_t)item);
+
+	printf("deque stats: steals %ld; grows %ld\n", d->steal_count, d->grow_count);
+
+	deque_destroy(d);
+
+	return 0;
+}
@@ -0,0 +1,100 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include "deque.h"
+
+#define RED "\033[41m"
+#define NOCOLOR "\033[0m"
+
+#define ITEMS 10000000
+#define THIEVES 3
+
+// The owner pushes ITEMS items and pops some back, thieves steal the
+// rest. Every item must be taken exactly once.
+static unsigned char *taken;
+static long total;
+static volatile int done;
+
+static void take(intptr_t item) {
+	if (__atomic_fetch_add(&taken[item], 1, __ATOMIC_RELAXED))
+		printf(RED"ERROR: item %ld taken twice" NOCOLOR "\n", item);
+
+	__atomic_fetch_add(&total, 1, __ATOMIC_RELAXED);
+}
+
+void *thief(void *arg) {
+	deque_t *d = (deque_t *)arg;
+	void *item;
+
+	printf("thief [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	while (!done) {
+		int ret = deque_steal(d, &item);
+
+		if (ret == DEQUE_OK)
+			take((intptr_t)item);
+		else if (ret == DEQUE_EMPTY)
+			sched_yield();
+	}
+
+	return NULL;
+}
+
+int main() {
+	pthread_t tids[THIEVES];
+	deque_t *d;
+	void *item;
+	int err;
+
+	printf("main [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	taken = calloc(ITEMS, 1);
+	d = deque_init(16);
+
+	for (int i = 0; i < THIEVES; i++) {
+		err = pthread_create(&tids[i], NULL, thief, d);
+		if (err) {
+			printf("main: pthread_create() failed: %s\n", strerror(err));
+			return -1;
+		}
+	}
+
+	for (intptr_t i = 0; i < ITEMS; i++) {
+		deque_push(d, (void *)i);
+
+		// pop every third item back, keep the rest for the thieves
+		if (i % 3 == 0 && deque_pop(d, &item))
+			take((intptr_t)item);
+	}
+
+	while (deque_pop(d, &item))
+		take((intptr_t)item);
+
+	// the deque can look empty while a thief is between its read and CAS
+	while (__atomic_load_n(&total, __ATOMIC_RELAXED) < ITEMS)
+		sched_yield();
+
+	done = 1;
+	for (int i = 0; i < THIEVES; i++)
+		pthread_join(tids[i], NULL);
+
+	for (long i = 0; i < ITEMS; i++)
+		if (taken[i] != 1)
+			printf(RED"ERROR: item %ld taken %d times" NOCOLOR "\n", i, taken[i]);
+
+	printf("deque stats: items %ld; steals %ld; grows %ld\n",
+		total, d->steal_count, d->grow_count);
+
+	deque_destroy(d);
+	free(taken);
+
+	return 0;
+}
@@ -0,0 +1,147 @@
+#include "deque.h"
+
+// Orderings follow Le, Pop, Cohen, Zappa Nardelli, "Correct and Efficient
+// Work-Stealing for Weak Memory Models" (PPoPP 2013).
+#define LOAD(ptr, mo) __atomic_load_n(ptr, __ATOMIC_##mo)
+#define STORE(ptr, val, mo) __atomic_store_n(ptr, val, __ATOMIC_##mo)
+#define FENCE(mo) __atomic_thread_fence(__ATOMIC_##mo)
+#define CAS(ptr, expected, desired) \
+	__atomic_compare_exchange_n(ptr, expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)
+
+static darray_t *darray_new(long size) {
+	darray_t *a = malloc(sizeof(darray_t) + size * sizeof(void *));
+	if (!a) {
+		printf("Cannot allocate memory for a deque array\n");
+		abort();
+	}
+
+	a->size = size;
+	a->prev = NULL;
+	return a;
+}
+
+static void *darray_get(darray_t *a, long i) {
+	return LOAD(&a->buf[i & (a->size - 1)], RELAXED);
+}
+
+static void darray_put(darray_t *a, long i, void *item) {
+	STORE(&a->buf[i & (a->size - 1)], item, RELAXED);
+}
+
+deque_t *deque_init(int size) {
+	long n = 1;
+	deque_t *d;
+	int err;
+
+	while (n < size)
+		n <<= 1;
+
+	err = posix_memalign((void **)&d, CACHE_LINE_SIZE, sizeof(deque_t));
+	if (err) {
+		printf("Cannot allocate memory for a deque\n");
+		abort();
+	}
+
+	d->top = d->bottom = 0;
+	d->array = darray_new(n);
+	d->steal_count = d->grow_count = 0;
+
+	return d;
+}
+
+void deque_destroy(deque_t *d) {
+	darray_t *a = d->array;
+
+	while (a) {
+		darray_t *prev = a->prev;
+		free(a);
+		a = prev;
+	}
+
+	free(d);
+}
+
+// A thief may have loaded the old array and still be reading from it, so
+// old arrays are only freed with the deque. Their total size is smaller
+// than the current one.
+static darray_t *deque_grow(deque_t *d, darray_t *a, long b, long t) {
+	darray_t *new = darray_new(a->size * 2);
+
+	for (long i = t; i < b; i++)
+		darray_put(new, i, darray_get(a, i));
+
+	new->prev = a;
+	STORE(&d->array, new, RELEASE);
+	d->grow_count++;
+
+	return new;
+}
+
+void deque_push(deque_t *d, void *item) {
+	long b = LOAD(&d->bottom, RELAXED);
+	long t = LOAD(&d->top, ACQUIRE);
+	darray_t *a = LOAD(&d->array, RELAXED);
+
+	if (b - t > a->size - 1)
+		a = deque_grow(d, a, b, t);
+
+	darray_put(a, b, item);
+	FENCE(RELEASE);
+	STORE(&d->bottom, b + 1, RELAXED);
+}
+
+int deque_pop(deque_t *d, void **item) {
+	long b = LOAD(&d->bottom, RELAXED) - 1;
+	darray_t *a = LOAD(&d->array, RELAXED);
+	long t;
+	int ok = 1;
+
+	STORE(&d->bottom, b, RELAXED);
+	// orders the bottom store before the top load; pairs with the fence
+	// in deque_steal so owner and thief cannot both miss each other
+	FENCE(SEQ_CST);
+	t = LOAD(&d->top, RELAXED);
+
+	if (t > b) {
+		// empty
+		STORE(&d->bottom, b + 1, RELAXED);
+		return 0;
+	}
+
+	*item = darray_get(a, b);
+
+	if (t == b) {
+		// last item: race the thieves for it
+		if (!CAS(&d->top, &t, t + 1))
+			ok = 0;
+		STORE(&d->bottom, b + 1, RELAXED);
+	}
+
+	return ok;
+}
+
+int deque_steal(deque_t *d, void **item) {
+	long t = LOAD(&d->top, ACQUIRE);
+	long b;
+
+	FENCE(SEQ_CST);
+	b = LOAD(&d->bottom, ACQUIRE);
+
+	if (t >= b)
+		return DEQUE_EMPTY;
+
+	*item = darray_get(LOAD(&d->array, ACQUIRE), t);
+
+	if (!CAS(&d->top, &t, t + 1))
+		return DEQUE_ABORT;
+
+	__atomic_fetch_add(&d->steal_count, 1, __ATOMIC_RELAXED);
+	return DEQUE_OK;
+}
+
+long deque_size(deque_t *d) {
+	long b = LOAD(&d->bottom, RELAXED);
+	long t = LOAD(&d->top, RELAXED);
+
+	return b > t ? b - t : 0;
+}
@@ -0,0 +1,50 @@
+#ifndef __FITOS_DEQUE_H__
+#define __FITOS_DEQUE_H__
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define CACHE_LINE_SIZE 64
+
+// deque_steal results
+#define DEQUE_OK 1
+#define DEQUE_EMPTY 0
+#define DEQUE_ABORT -1		// lost a race, the deque may still have items
+
+typedef struct _DequeArray {
+	long size;		// power of 2
+	struct _DequeArray *prev;	// smaller arrays, kept for late thieves
+	void *buf[];
+} darray_t;
+
+// Chase-Lev work-stealing deque. One owner thread pushes and pops at the
+// bottom; any number of thieves take from the top. The owner only uses
+// plain loads and stores plus one fence in deque_pop; a CAS is needed
+// only when owner and thieves compete for the last item.
+typedef struct _Deque {
+	// written by thieves
+	long top __attribute__((aligned(CACHE_LINE_SIZE)));
+
+	// written by the owner
+	long bottom __attribute__((aligned(CACHE_LINE_SIZE)));
+	darray_t *array;
+
+	long steal_count __attribute__((aligned(CACHE_LINE_SIZE)));
+	long grow_count;
+} deque_t;
+
+deque_t *deque_init(int size);
+void deque_destroy(deque_t *d);
+
+// owner only
+void deque_push(deque_t *d, void *item);
+int deque_pop(deque_t *d, void **item);
+
+// any thread
+int deque_steal(deque_t *d, void **item);
+long deque_size(deque_t *d);
+
+#endif		// __FITOS_DEQUE_H__
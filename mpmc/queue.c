@@ -0,0 +1,161 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <assert.h>
+
+#include "queue.h"
+
+#define LOAD_RELAXED(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define LOAD_ACQUIRE(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+#define CAS_RELAXED(ptr, old, new) \
+	__atomic_compare_exchange_n(ptr, old, new, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#define ATOMIC_INC(ptr) __atomic_fetch_add(ptr, 1, __ATOMIC_RELAXED)
+
+static unsigned long ring_size(int max_count) {
+    unsigned long size = 2;
+
+    while (size < (unsigned long)max_count)
+        size <<= 1;
+
+    return size;
+}
+
+void *qmonitor(void *arg) {
+	queue_t *q = (queue_t *)arg;
+
+	printf("qmonitor: [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	while (1) {
+		queue_print_stats(q);
+		sleep(1);
+	}
+
+	return NULL;
+}
+
+queue_t* queue_init(int max_count) {
+    int err;
+    queue_t *q;
+
+    assert(max_count > 0);
+
+    err = posix_memalign((void **)&q, CACHE_LINE_SIZE, sizeof(queue_t));
+    if (err) {
+        printf("Cannot allocate memory for a queue\n");
+        abort();
+    }
+
+    q->max_count = max_count;
+    q->mask = ring_size(max_count) - 1;
+
+    q->cells = malloc((q->mask + 1) * sizeof(qcell_t));
+    if (!q->cells) {
+        printf("Cannot allocate memory for queue cells\n");
+        free(q);
+        abort();
+    }
+
+    for (unsigned long i = 0; i <= q->mask; i++)
+        q->cells[i].seq = i;
+
+    q->enqueue_pos = q->dequeue_pos = 0;
+
+    q->add_attempts = q->get_attempts = 0;
+    q->add_count = q->get_count = 0;
+
+    q->monitor = getenv(QMONITOR_ENV) != NULL;
+    err = q->monitor ? pthread_create(&q->qmonitor_tid, NULL, qmonitor, q) : 0;
+    if (err) {
+        printf("queue_init: pthread_create() failed: %s\n", strerror(err));
+        free(q->cells);
+        free(q);
+        abort();
+    }
+
+    return q;
+}
+
+void queue_destroy(queue_t *q) {
+    if (q == NULL) return;
+
+    if (q->monitor) {
+        pthread_cancel(q->qmonitor_tid);
+        pthread_join(q->qmonitor_tid, NULL);
+    }
+
+    free(q->cells);
+    free(q);
+}
+
+int queue_add(queue_t *q, int val) {
+    unsigned long pos = LOAD_RELAXED(&q->enqueue_pos);
+    qcell_t *cell;
+
+    ATOMIC_INC(&q->add_attempts);
+
+    while (1) {
+        cell = &q->cells[pos & q->mask];
+        long dif = (long)(LOAD_ACQUIRE(&cell->seq) - pos);
+
+        // the ring may be larger than max_count. dequeue_pos only grows,
+        // so a stale value can only make the queue look fuller.
+        if ((long)(pos - LOAD_ACQUIRE(&q->dequeue_pos)) >= q->max_count)
+            return 0;
+
+        if (dif == 0) {
+            // slot is free for pos: claim it (on failure pos is reloaded)
+            if (CAS_RELAXED(&q->enqueue_pos, &pos, pos + 1))
+                break;
+        } else if (dif < 0) {
+            // slot still holds the value from the previous lap: full
+            return 0;
+        } else {
+            pos = LOAD_RELAXED(&q->enqueue_pos);
+        }
+    }
+
+    cell->val = val;
+    STORE_RELEASE(&cell->seq, pos + 1);
+
+    ATOMIC_INC(&q->add_count);
+    return 1;
+}
+
+int queue_get(queue_t *q, int *val) {
+    unsigned long pos = LOAD_RELAXED(&q->dequeue_pos);
+    qcell_t *cell;
+
+    ATOMIC_INC(&q->get_attempts);
+
+    while (1) {
+        cell = &q->cells[pos & q->mask];
+        long dif = (long)(LOAD_ACQUIRE(&cell->seq) - (pos + 1));
+
+        if (dif == 0) {
+            if (CAS_RELAXED(&q->dequeue_pos, &pos, pos + 1))
+                break;
+        } else if (dif < 0) {
+            // producer for pos has not published yet: empty
+            return 0;
+        } else {
+            pos = LOAD_RELAXED(&q->dequeue_pos);
+        }
+    }
+
+    *val = cell->val;
+    // hand the slot to the producer of the next lap
+    STORE_RELEASE(&cell->seq, pos + q->mask + 1);
+
+    ATOMIC_INC(&q->get_count);
+    return 1;
+}
+
+void queue_print_stats(queue_t *q) {
+	unsigned long dequeue_pos = LOAD_RELAXED(&q->dequeue_pos);
+	unsigned long enqueue_pos = LOAD_RELAXED(&q->enqueue_pos);
+
+	printf("queue stats: current size %ld; attempts: (%ld %ld %ld); counts (%ld %ld %ld)\n",
+		(long)(enqueue_pos - dequeue_pos),
+		q->add_attempts, q->get_attempts, q->add_attempts - q->get_attempts,
+		q->add_count, q->get_count, q->add_count -q->get_count);
+}
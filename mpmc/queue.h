@@ -0,0 +1,55 @@
+#ifndef __FITOS_QUEUE_H__
+#define __FITOS_QUEUE_H__
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "qmonitor.h"
+
+#define CACHE_LINE_SIZE 64
+
+// Ring slot. seq tells whose turn it is: seq == pos means the slot is free
+// for the producer that claims pos, seq == pos + 1 means it holds the value
+// for the consumer that claims pos.
+typedef struct _QueueCell {
+	unsigned long seq;
+	int val;
+} qcell_t;
+
+// Bounded multi-producer multi-consumer queue (sequence-numbered ring).
+// The ring has a power of 2 cells, at least 2: with a single cell "full"
+// and "free for the next lap" would be the same seq. max_count is
+// enforced against dequeue_pos, so it need not be the ring size.
+typedef struct _Queue {
+	// producer side
+	unsigned long enqueue_pos __attribute__((aligned(CACHE_LINE_SIZE)));
+	long add_attempts;
+	long add_count;
+
+	// consumer side
+	unsigned long dequeue_pos __attribute__((aligned(CACHE_LINE_SIZE)));
+	long get_attempts;
+	long get_count;
+
+	// read-only after queue_init
+	qcell_t *cells __attribute__((aligned(CACHE_LINE_SIZE)));
+	unsigned long mask;	// ring size - 1
+	int max_count;
+
+	pthread_t qmonitor_tid;
+	int monitor;
+} queue_t;
+
+queue_t* queue_init(int max_count);
+void queue_destroy(queue_t *q);
+int queue_add(queue_t *q, int val);
+int queue_get(queue_t *q, int *val);
+void queue_print_stats(queue_t *q);
+
+#endif		// __FITOS_QUEUE_H__
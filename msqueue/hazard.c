@@ -0,0 +1,183 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "hazard.h"
+
+#define LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_SEQ_CST)
+#define STORE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_SEQ_CST)
+#define CAS(ptr, old, new) \
+	__atomic_compare_exchange_n(ptr, old, new, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+
+// Records are never freed: a thread that exits gives its record back and
+// the next new thread reuses it together with any pointers still retired.
+static hp_rec_t *hp_list;
+static int hp_records;
+
+static __thread hp_rec_t *hp_self;
+
+static pthread_key_t hp_key;
+static pthread_once_t hp_key_once = PTHREAD_ONCE_INIT;
+
+static void hp_release(void *arg) {
+	hp_rec_t *rec = (hp_rec_t *)arg;
+
+	for (int i = 0; i < HP_PER_THREAD; i++)
+		STORE(&rec->hp[i], NULL);
+
+	hp_scan();
+
+	hp_self = NULL;
+	STORE(&rec->active, 0);
+}
+
+static void hp_key_create(void) {
+	int err = pthread_key_create(&hp_key, hp_release);
+	if (err) {
+		printf("hp_key_create: pthread_key_create() failed: %s\n", strerror(err));
+		abort();
+	}
+}
+
+static hp_rec_t *hp_acquire(void) {
+	hp_rec_t *rec;
+
+	if (hp_self)
+		return hp_self;
+
+	pthread_once(&hp_key_once, hp_key_create);
+
+	for (rec = LOAD(&hp_list); rec; rec = rec->next) {
+		int inactive = 0;
+
+		if (LOAD(&rec->active) == 0 && CAS(&rec->active, &inactive, 1))
+			break;
+	}
+
+	if (!rec) {
+		rec = calloc(1, sizeof(hp_rec_t));
+		if (!rec) {
+			printf("Cannot allocate memory for a hazard record\n");
+			abort();
+		}
+
+		rec->active = 1;
+		rec->retired_max = HP_RETIRE_THRESHOLD;
+		rec->retired = malloc(rec->retired_max * sizeof(void *));
+		if (!rec->retired) {
+			printf("Cannot allocate memory for a retire list\n");
+			abort();
+		}
+
+		rec->next = LOAD(&hp_list);
+		while (!CAS(&hp_list, &rec->next, rec))
+			;
+
+		__atomic_fetch_add(&hp_records, 1, __ATOMIC_SEQ_CST);
+	}
+
+	hp_self = rec;
+	pthread_setspecific(hp_key, rec);
+
+	return rec;
+}
+
+void *hp_protect(int idx, void **src) {
+	hp_rec_t *rec = hp_acquire();
+	void *p = LOAD(src);
+
+	while (1) {
+		STORE(&rec->hp[idx], p);
+
+		void *again = LOAD(src);
+		if (again == p)
+			return p;
+
+		p = again;
+	}
+}
+
+void hp_set(int idx, void *p) {
+	hp_rec_t *rec = hp_acquire();
+
+	STORE(&rec->hp[idx], p);
+}
+
+void hp_clear(void) {
+	hp_rec_t *rec = hp_acquire();
+
+	for (int i = 0; i < HP_PER_THREAD; i++)
+		STORE(&rec->hp[i], NULL);
+}
+
+static int ptr_cmp(const void *a, const void *b) {
+	void *x = *(void **)a;
+	void *y = *(void **)b;
+
+	return (x > y) - (x < y);
+}
+
+void hp_scan(void) {
+	hp_rec_t *rec = hp_acquire();
+	hp_rec_t *head = LOAD(&hp_list);
+	int max = 0, n = 0, kept = 0;
+	void **hazards;
+
+	for (hp_rec_t *r = head; r; r = r->next)
+		max += HP_PER_THREAD;
+
+	hazards = malloc(max * sizeof(void *));
+	if (!hazards) {
+		printf("Cannot allocate memory for a hazard scan\n");
+		abort();
+	}
+
+	// Records pushed in front of head after we loaded it belong to new
+	// threads. They cannot hold pointers that were already unlinked.
+	for (hp_rec_t *r = head; r; r = r->next) {
+		for (int i = 0; i < HP_PER_THREAD; i++) {
+			void *p = LOAD(&r->hp[i]);
+			if (p)
+				hazards[n++] = p;
+		}
+	}
+
+	qsort(hazards, n, sizeof(void *), ptr_cmp);
+
+	for (int i = 0; i < rec->retired_count; i++) {
+		void *p = rec->retired[i];
+
+		if (bsearch(&p, hazards, n, sizeof(void *), ptr_cmp))
+			rec->retired[kept++] = p;
+		else
+			free(p);
+	}
+
+	rec->retired_count = kept;
+
+	free(hazards);
+}
+
+void hp_retire(void *p) {
+	hp_rec_t *rec = hp_acquire();
+
+	if (rec->retired_count == rec->retired_max) {
+		void **retired = realloc(rec->retired, 2 * rec->retired_max * sizeof(void *));
+		if (!retired) {
+			printf("Cannot allocate memory for a retire list\n");
+			abort();
+		}
+
+		rec->retired = retired;
+		rec->retired_max *= 2;
+	}
+
+	rec->retired[rec->retired_count++] = p;
+
+	// Up to hp_records * HP_PER_THREAD pointers may survive a scan, so keep
+	// the threshold above that to free a constant share on every scan.
+	if (rec->retired_count >= HP_RETIRE_THRESHOLD + LOAD(&hp_records) * HP_PER_THREAD)
+		hp_scan();
+}
@@ -0,0 +1,41 @@
+#ifndef __FITOS_HAZARD_H__
+#define __FITOS_HAZARD_H__
+
+#include <pthread.h>
+
+// Hazard pointers per thread. The Michael-Scott queue needs two:
+// the node being read and its successor.
+#define HP_PER_THREAD 2
+
+// Number of retired pointers a thread collects before it scans the
+// hazard pointers of all threads and frees what is no longer protected.
+#define HP_RETIRE_THRESHOLD 128
+
+typedef struct _HazardRecord {
+	void *hp[HP_PER_THREAD];
+	int active;
+	struct _HazardRecord *next;
+
+	// pointers retired by the owning thread, freed by hp_scan()
+	void **retired;
+	int retired_count;
+	int retired_max;
+} hp_rec_t;
+
+// Publish the pointer currently stored at *src in hazard slot idx and
+// return it. The returned pointer is safe to dereference until the slot
+// is overwritten or cleared.
+void *hp_protect(int idx, void **src);
+
+// Publish an already loaded pointer. The caller must re-validate that p is
+// still reachable after this call before dereferencing it.
+void hp_set(int idx, void *p);
+
+void hp_clear(void);
+
+// Hand p over for deferred free() once no hazard pointer refers to it.
+void hp_retire(void *p);
+
+void hp_scan(void);
+
+#endif		// __FITOS_HAZARD_H__
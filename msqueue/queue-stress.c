@@ -0,0 +1,141 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include "queue.h"
+
+// Stress test for the hazard pointer reclamation: half of the threads add,
+// the other half get, all of them race on the same few nodes. Built with
+// -fsanitize=address so any access to a freed qnode_t aborts the run.
+
+#define RED "\033[41m"
+#define NOCOLOR "\033[0m"
+
+static int producers;
+static long per_producer;
+static long total;
+
+static long claimed;
+static long errors;
+static unsigned char *seen;
+
+typedef struct {
+	queue_t *q;
+	int id;
+} thread_arg_t;
+
+void *reader(void *arg) {
+	thread_arg_t *t = (thread_arg_t *)arg;
+	int *last = malloc(producers * sizeof(int));
+
+	for (int p = 0; p < producers; p++)
+		last[p] = -1;
+
+	while (__atomic_fetch_add(&claimed, 1, __ATOMIC_RELAXED) < total) {
+		int val = -1;
+		while (!queue_get(t->q, &val))
+			sched_yield();
+
+		int p = val % producers;
+		int seq = val / producers;
+
+		if (val < 0 || val >= total || __atomic_exchange_n(&seen[val], 1, __ATOMIC_RELAXED)) {
+			printf(RED"ERROR: value %d is out of range or seen twice" NOCOLOR "\n", val);
+			__atomic_fetch_add(&errors, 1, __ATOMIC_RELAXED);
+			continue;
+		}
+
+		if (seq <= last[p]) {
+			printf(RED"ERROR: get value %d from producer %d after %d" NOCOLOR "\n", seq, p, last[p]);
+			__atomic_fetch_add(&errors, 1, __ATOMIC_RELAXED);
+		}
+
+		last[p] = seq;
+	}
+
+	free(last);
+	return NULL;
+}
+
+void *writer(void *arg) {
+	thread_arg_t *t = (thread_arg_t *)arg;
+
+	for (long i = 0; i < per_producer; i++)
+		queue_add(t->q, (int)(i * producers + t->id));
+
+	return NULL;
+}
+
+int main(int argc, char **argv) {
+	int threads = 16;
+	pthread_t *tids;
+	thread_arg_t *args;
+	queue_t *q;
+	int err;
+
+	per_producer = 200000;
+
+	if (argc > 1)
+		threads = atoi(argv[1]);
+	if (argc > 2)
+		per_producer = atol(argv[2]);
+
+	if (threads < 2 || per_producer <= 0) {
+		printf("usage: %s [threads >= 2] [items per producer]\n", argv[0]);
+		return -1;
+	}
+
+	producers = threads / 2;
+	total = producers * per_producer;
+
+	seen = calloc(total, 1);
+	tids = malloc(threads * sizeof(pthread_t));
+	args = malloc(threads * sizeof(thread_arg_t));
+	if (!seen || !tids || !args) {
+		printf("Cannot allocate memory for the test\n");
+		return -1;
+	}
+
+	printf("stress: %d producers, %d consumers, %ld items\n",
+		producers, threads - producers, total);
+
+	q = queue_init(1000);
+
+	for (int i = 0; i < threads; i++) {
+		args[i].q = q;
+		args[i].id = i;
+
+		err = pthread_create(&tids[i], NULL, i < producers ? writer : reader, &args[i]);
+		if (err) {
+			printf("main: pthread_create() failed: %s\n", strerror(err));
+			return -1;
+		}
+	}
+
+	for (int i = 0; i < threads; i++)
+		pthread_join(tids[i], NULL);
+
+	for (long v = 0; v < total; v++) {
+		if (!seen[v]) {
+			printf(RED"ERROR: value %ld was lost" NOCOLOR "\n", v);
+			errors++;
+		}
+	}
+
+	queue_print_stats(q);
+	queue_destroy(q);
+
+	printf("stress: %s, %ld errors\n", errors ? "FAILED" : "OK", errors);
+
+	free(seen);
+	free(tids);
+	free(args);
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,168 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <assert.h>
+
+#include "queue.h"
+#include "hazard.h"
+
+#define LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_SEQ_CST)
+#define CAS(ptr, old, new) ({ \
+	__typeof__(*(ptr)) __old = (old); \
+	__atomic_compare_exchange_n(ptr, &__old, new, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); \
+})
+#define ATOMIC_INC(ptr) __atomic_fetch_add(ptr, 1, __ATOMIC_RELAXED)
+
+void *qmonitor(void *arg) {
+	queue_t *q = (queue_t *)arg;
+
+	printf("qmonitor: [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	while (1) {
+		queue_print_stats(q);
+		sleep(1);
+	}
+
+	return NULL;
+}
+
+queue_t* queue_init(int max_count) {
+    int err;
+    queue_t *q;
+
+    err = posix_memalign((void **)&q, CACHE_LINE_SIZE, sizeof(queue_t));
+    if (err) {
+        printf("Cannot allocate memory for a queue\n");
+        abort();
+    }
+
+    qnode_t *dummy = malloc(sizeof(qnode_t));
+    if (!dummy) {
+        printf("Cannot allocate memory for a dummy node\n");
+        free(q);
+        abort();
+    }
+
+    dummy->next = NULL;
+
+    q->first = q->last = dummy;
+    q->max_count = max_count;
+
+    q->add_attempts = q->get_attempts = 0;
+    q->add_count = q->get_count = 0;
+
+    q->monitor = getenv(QMONITOR_ENV) != NULL;
+    err = q->monitor ? pthread_create(&q->qmonitor_tid, NULL, qmonitor, q) : 0;
+    if (err) {
+        printf("queue_init: pthread_create() failed: %s\n", strerror(err));
+        free(dummy);
+        free(q);
+        abort();
+    }
+
+    return q;
+}
+
+// Must not race with queue_add/queue_get. Nodes already retired by other
+// threads are freed by their hazard pointer scans, not here.
+void queue_destroy(queue_t *q) {
+    if (q == NULL) return;
+
+    if (q->monitor) {
+        pthread_cancel(q->qmonitor_tid);
+        pthread_join(q->qmonitor_tid, NULL);
+    }
+
+    qnode_t *current = q->first;
+    while (current != NULL) {
+        qnode_t *temp = current;
+        current = current->next;
+        free(temp);
+    }
+
+    free(q);
+}
+
+int queue_add(queue_t *q, int val) {
+    ATOMIC_INC(&q->add_attempts);
+
+    qnode_t *new = malloc(sizeof(qnode_t));
+    if (!new) {
+        printf("Cannot allocate memory for new node\n");
+        abort();
+    }
+
+    new->val = val;
+    new->next = NULL;
+
+    while (1) {
+        qnode_t *last = hp_protect(0, (void **)&q->last);
+        qnode_t *next = LOAD(&last->next);
+
+        if (last != LOAD(&q->last))
+            continue;
+
+        if (next != NULL) {
+            // last is lagging behind: help the other producer move it
+            CAS(&q->last, last, next);
+            continue;
+        }
+
+        if (CAS(&last->next, NULL, new)) {
+            CAS(&q->last, last, new);
+            break;
+        }
+    }
+
+    hp_clear();
+
+    ATOMIC_INC(&q->add_count);
+    return 1;
+}
+
+int queue_get(queue_t *q, int *val) {
+    qnode_t *first;
+
+    ATOMIC_INC(&q->get_attempts);
+
+    while (1) {
+        first = hp_protect(0, (void **)&q->first);
+        qnode_t *last = LOAD(&q->last);
+        qnode_t *next = LOAD(&first->next);
+
+        // next cannot be retired while first is still the head
+        hp_set(1, next);
+        if (first != LOAD(&q->first))
+            continue;
+
+        if (next == NULL) {
+            hp_clear();
+            return 0;
+        }
+
+        if (first == last) {
+            CAS(&q->last, last, next);
+            continue;
+        }
+
+        *val = next->val;
+
+        if (CAS(&q->first, first, next))
+            break;
+    }
+
+    hp_clear();
+    hp_retire(first);
+
+    ATOMIC_INC(&q->get_count);
+    return 1;
+}
+
+void queue_print_stats(queue_t *q) {
+	long get_count = LOAD(&q->get_count);
+	long add_count = LOAD(&q->add_count);
+
+	printf("queue stats: current size %ld; attempts: (%ld %ld %ld); counts (%ld %ld %ld)\n",
+		add_count - get_count,
+		q->add_attempts, q->get_attempts, q->add_attempts - q->get_attempts,
+		add_count, get_count, add_count - get_count);
+}
@@ -0,0 +1,50 @@
+#ifndef __FITOS_QUEUE_H__
+#define __FITOS_QUEUE_H__
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "qmonitor.h"
+
+#define CACHE_LINE_SIZE 64
+
+typedef struct _QueueNode {
+	int val;
+	struct _QueueNode *next;
+} qnode_t;
+
+// Unbounded Michael-Scott lock-free queue. first always points to a dummy
+// node; the first value lives in first->next. Dequeued nodes are freed
+// through hazard pointers (hazard.h), never while another thread may read
+// them.
+typedef struct _Queue {
+	// consumer side
+	qnode_t *first __attribute__((aligned(CACHE_LINE_SIZE)));
+	long get_attempts;
+	long get_count;
+
+	// producer side
+	qnode_t *last __attribute__((aligned(CACHE_LINE_SIZE)));
+	long add_attempts;
+	long add_count;
+
+	// max_count is kept for API compatibility only: the queue is unbounded
+	int max_count __attribute__((aligned(CACHE_LINE_SIZE)));
+
+	pthread_t qmonitor_tid;
+	int monitor;
+} queue_t;
+
+queue_t* queue_init(int max_count);
+void queue_destroy(queue_t *q);
+int queue_add(queue_t *q, int val);
+int queue_get(queue_t *q, int *val);
+void queue_print_stats(queue_t *q);
+
+#endif		// __FITOS_QUEUE_H__
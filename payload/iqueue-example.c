@@ -0,0 +1,63 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include "iqueue.h"
+
+// the link lives inside the message, the queue allocates nothing
+typedef struct {
+	int id;
+	qlink_t link;
+	size_t len;
+	char data[];
+} msg_t;
+
+int main() {
+	iqueue_t *q;
+	msg_t *msgs[10];
+
+	printf("main: [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	q = iqueue_init(1000);
+
+	for (int i = 0; i < 10; i++) {
+		size_t len = i + 1;
+
+		msgs[i] = malloc(sizeof(msg_t) + len);
+		if (!msgs[i]) {
+			printf("Cannot allocate memory for a message\n");
+			abort();
+		}
+
+		msgs[i]->id = i;
+		msgs[i]->len = len;
+		memset(msgs[i]->data, 'a' + i, len);
+
+		int ok = iqueue_add(q, &msgs[i]->link);
+
+		printf("ok %d: add message %d\n", ok, i);
+
+		iqueue_print_stats(q);
+	}
+
+	for (int i = 0; i < 10; i++) {
+		msg_t *m = qlink_entry(iqueue_get(q), msg_t, link);
+
+		printf("get message %d: %zu bytes of '%c'\n", m->id, m->len, m->data[0]);
+
+		iqueue_print_stats(q);
+	}
+
+	iqueue_destroy(q);
+
+	for (int i = 0; i < 10; i++)
+		free(msgs[i]);
+
+	return 0;
+}
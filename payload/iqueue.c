@@ -0,0 +1,152 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <assert.h>
+
+#include "iqueue.h"
+
+void *iqmonitor(void *arg) {
+	iqueue_t *q = (iqueue_t *)arg;
+
+	printf("iqmonitor: [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	while (1) {
+		iqueue_print_stats(q);
+		sleep(1);
+	}
+
+	return NULL;
+}
+
+iqueue_t* iqueue_init(int max_count) {
+    int err;
+
+    iqueue_t *q = malloc(sizeof(iqueue_t));
+    if (!q) {
+        printf("Cannot allocate memory for a queue\n");
+        abort();
+    }
+
+    q->first = NULL;
+    q->last = NULL;
+    q->max_count = max_count;
+    q->count = 0;
+
+    q->add_attempts = q->get_attempts = 0;
+    q->add_count = q->get_count = 0;
+
+    err = pthread_mutex_init(&q->lock, NULL);
+    if (err) {
+        printf("iqueue_init: pthread_mutex_init failed: %s\n", strerror(err));
+        free(q);
+        abort();
+    }
+
+    err = pthread_cond_init(&q->not_empty, NULL);
+    if (err) {
+        printf("iqueue_init: pthread_cond_init (not_empty) failed: %s\n", strerror(err));
+        pthread_mutex_destroy(&q->lock);
+        free(q);
+        abort();
+    }
+
+    err = pthread_cond_init(&q->not_full, NULL);
+    if (err) {
+        printf("iqueue_init: pthread_cond_init (not_full) failed: %s\n", strerror(err));
+        pthread_mutex_destroy(&q->lock);
+        pthread_cond_destroy(&q->not_empty);
+        free(q);
+        abort();
+    }
+
+    q->monitor = getenv(QMONITOR_ENV) != NULL;
+    err = q->monitor ? pthread_create(&q->qmonitor_tid, NULL, iqmonitor, q) : 0;
+    if (err) {
+        printf("iqueue_init: pthread_create() failed: %s\n", strerror(err));
+        pthread_mutex_destroy(&q->lock);
+        pthread_cond_destroy(&q->not_empty);
+        pthread_cond_destroy(&q->not_full);
+        free(q);
+        abort();
+    }
+
+    return q;
+}
+
+// Messages still linked in belong to the caller and are not touched here.
+void iqueue_destroy(iqueue_t *q) {
+    if (q == NULL) return;
+
+    if (q->monitor) {
+        pthread_cancel(q->qmonitor_tid);
+        pthread_join(q->qmonitor_tid, NULL);
+    }
+
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+
+    free(q);
+}
+
+int iqueue_add(iqueue_t *q, qlink_t *link) {
+    link->next = NULL;
+
+    pthread_mutex_lock(&q->lock);
+
+    while (q->count == q->max_count) {
+        pthread_cond_wait(&q->not_full, &q->lock);
+    }
+
+    q->add_attempts++;
+
+    assert(q->count < q->max_count);
+
+    if (!q->first)
+        q->first = q->last = link;
+    else {
+        q->last->next = link;
+        q->last = link;
+    }
+
+    q->count++;
+    q->add_count++;
+
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+    return 1;
+}
+
+qlink_t *iqueue_get(iqueue_t *q) {
+    qlink_t *link;
+
+    pthread_mutex_lock(&q->lock);
+
+    while (q->count == 0) {
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    }
+
+    q->get_attempts++;
+
+    assert(q->count > 0);
+
+    link = q->first;
+    q->first = link->next;
+    if (!q->first)
+        q->last = NULL;
+
+    q->count--;
+    q->get_count++;
+
+    pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+
+    link->next = NULL;
+    return link;
+}
+
+void iqueue_print_stats(iqueue_t *q) {
+	printf("iqueue stats: current size %d; attempts: (%ld %ld %ld); counts (%ld %ld %ld)\n",
+		q->count,
+		q->add_attempts, q->get_attempts, q->add_attempts - q->get_attempts,
+		q->add_count, q->get_count, q->add_count -q->get_count);
+}
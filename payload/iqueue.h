@@ -0,0 +1,61 @@
+#ifndef __FITOS_IQUEUE_H__
+#define __FITOS_IQUEUE_H__
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "qmonitor.h"
+
+// Link embedded by the caller into its own message struct:
+//
+//	struct msg {
+//		qlink_t link;
+//		size_t len;
+//		char data[];
+//	};
+//
+// iqueue_add(q, &m->link) / qlink_entry(iqueue_get(q), struct msg, link)
+typedef struct _QueueLink {
+	struct _QueueLink *next;
+} qlink_t;
+
+#define qlink_entry(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+// Blocking intrusive queue: the list is threaded through the callers'
+// messages, so it has no storage of its own and never allocates.
+// A message must not be in two queues at once.
+typedef struct _IQueue {
+	qlink_t *first;
+	qlink_t *last;
+
+	pthread_t qmonitor_tid;
+	int monitor;
+
+	int count;
+	int max_count;
+
+	// queue statistics
+	long add_attempts;
+	long get_attempts;
+	long add_count;
+	long get_count;
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+} iqueue_t;
+
+iqueue_t* iqueue_init(int max_count);
+void iqueue_destroy(iqueue_t *q);
+int iqueue_add(iqueue_t *q, qlink_t *link);
+qlink_t *iqueue_get(iqueue_t *q);
+void iqueue_print_stats(iqueue_t *q);
+
+#endif		// __FITOS_IQUEUE_H__
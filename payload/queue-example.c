@@ -0,0 +1,67 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include "queue.h"
+
+// variable-size message: the queue carries only the pointer
+typedef struct {
+	size_t len;
+	char data[];
+} msg_t;
+
+msg_t *msg_new(const char *text) {
+	size_t len = strlen(text) + 1;
+	msg_t *m = malloc(sizeof(msg_t) + len);
+
+	if (!m) {
+		printf("Cannot allocate memory for a message\n");
+		abort();
+	}
+
+	m->len = len;
+	memcpy(m->data, text, len);
+	return m;
+}
+
+int main() {
+	queue_t *q;
+
+	printf("main: [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	q = queue_init(1000);
+
+	for (int i = 0; i < 10; i++) {
+		char text[32];
+
+		snprintf(text, sizeof(text), "message %*d", i + 1, i);
+
+		int ok = queue_add(q, msg_new(text));
+
+		printf("ok %d: add \"%s\"\n", ok, text);
+
+		queue_print_stats(q);
+	}
+
+	for (int i = 0; i < 10; i++) {
+		void *ptr = NULL;
+		int ok = queue_get(q, &ptr);
+		msg_t *m = (msg_t *)ptr;
+
+		printf("ok: %d: get \"%s\" (%zu bytes)\n", ok, m->data, m->len);
+
+		free(m);
+
+		queue_print_stats(q);
+	}
+
+	queue_destroy(q);
+
+	return 0;
+}
@@ -0,0 +1,155 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <assert.h>
+
+#include "queue.h"
+
+void *qmonitor(void *arg) {
+	queue_t *q = (queue_t *)arg;
+
+	printf("qmonitor: [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	while (1) {
+		queue_print_stats(q);
+		sleep(1);
+	}
+
+	return NULL;
+}
+
+queue_t* queue_init(int max_count) {
+    int err;
+
+    assert(max_count > 0);
+
+    queue_t *q = malloc(sizeof(queue_t));
+    if (!q) {
+        printf("Cannot allocate memory for a queue\n");
+        abort();
+    }
+
+    q->ring = malloc(max_count * sizeof(void *));
+    if (!q->ring) {
+        printf("Cannot allocate memory for a queue ring\n");
+        free(q);
+        abort();
+    }
+
+    q->head = q->tail = 0;
+    q->max_count = max_count;
+    q->count = 0;
+
+    q->add_attempts = q->get_attempts = 0;
+    q->add_count = q->get_count = 0;
+
+    err = pthread_mutex_init(&q->lock, NULL);
+    if (err) {
+        printf("queue_init: pthread_mutex_init failed: %s\n", strerror(err));
+        free(q->ring);
+        free(q);
+        abort();
+    }
+
+    err = pthread_cond_init(&q->not_empty, NULL);
+    if (err) {
+        printf("queue_init: pthread_cond_init (not_empty) failed: %s\n", strerror(err));
+        pthread_mutex_destroy(&q->lock);
+        free(q->ring);
+        free(q);
+        abort();
+    }
+
+    err = pthread_cond_init(&q->not_full, NULL);
+    if (err) {
+        printf("queue_init: pthread_cond_init (not_full) failed: %s\n", strerror(err));
+        pthread_mutex_destroy(&q->lock);
+        pthread_cond_destroy(&q->not_empty);
+        free(q->ring);
+        free(q);
+        abort();
+    }
+
+    q->monitor = getenv(QMONITOR_ENV) != NULL;
+    err = q->monitor ? pthread_create(&q->qmonitor_tid, NULL, qmonitor, q) : 0;
+    if (err) {
+        printf("queue_init: pthread_create() failed: %s\n", strerror(err));
+        pthread_mutex_destroy(&q->lock);
+        pthread_cond_destroy(&q->not_empty);
+        pthread_cond_destroy(&q->not_full);
+        free(q->ring);
+        free(q);
+        abort();
+    }
+
+    return q;
+}
+
+// Messages still queued belong to the caller and are not freed here.
+void queue_destroy(queue_t *q) {
+    if (q == NULL) return;
+
+    if (q->monitor) {
+        pthread_cancel(q->qmonitor_tid);
+        pthread_join(q->qmonitor_tid, NULL);
+    }
+
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+
+    free(q->ring);
+    free(q);
+}
+
+int queue_add(queue_t *q, void *msg) {
+    pthread_mutex_lock(&q->lock);
+
+    while (q->count == q->max_count) {
+        pthread_cond_wait(&q->not_full, &q->lock);
+    }
+
+    q->add_attempts++;
+
+    assert(q->count < q->max_count);
+
+    q->ring[q->tail] = msg;
+    if (++q->tail == q->max_count)
+        q->tail = 0;
+
+    q->count++;
+    q->add_count++;
+
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+    return 1;
+}
+
+int queue_get(queue_t *q, void **msg) {
+    pthread_mutex_lock(&q->lock);
+
+    while (q->count == 0) {
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    }
+
+    q->get_attempts++;
+
+    assert(q->count > 0);
+
+    *msg = q->ring[q->head];
+    if (++q->head == q->max_count)
+        q->head = 0;
+
+    q->count--;
+    q->get_count++;
+
+    pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+    return 1;
+}
+
+void queue_print_stats(queue_t *q) {
+	printf("queue stats: current size %d; attempts: (%ld %ld %ld); counts (%ld %ld %ld)\n",
+		q->count,
+		q->add_attempts, q->get_attempts, q->add_attempts - q->get_attempts,
+		q->add_count, q->get_count, q->add_count -q->get_count);
+}
@@ -0,0 +1,45 @@
+#ifndef __FITOS_QUEUE_H__
+#define __FITOS_QUEUE_H__
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "qmonitor.h"
+
+// Blocking queue of opaque pointers. The queue never copies or allocates
+// per message: it stores the caller's pointer in a ring preallocated by
+// queue_init. Ownership of the message passes from queue_add to queue_get.
+typedef struct _Queue {
+	void **ring;
+	int head;
+	int tail;
+
+	pthread_t qmonitor_tid;
+	int monitor;
+
+	int count;
+	int max_count;
+
+	// queue statistics
+	long add_attempts;
+	long get_attempts;
+	long add_count;
+	long get_count;
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+} queue_t;
+
+queue_t* queue_init(int max_count);
+void queue_destroy(queue_t *q);
+int queue_add(queue_t *q, void *msg);
+int queue_get(queue_t *q, void **msg);
+void queue_print_stats(queue_t *q);
+
+#endif		// __FITOS_QUEUE_H__
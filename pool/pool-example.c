@@ -0,0 +1,58 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+#define TASKS 10
+
+static long sum;
+
+void *square(void *arg) {
+	intptr_t x = (intptr_t)arg;
+
+	return (void *)(x * x);
+}
+
+void *add(void *arg) {
+	__atomic_fetch_add(&sum, (intptr_t)arg, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+int main() {
+	pool_future_t futures[TASKS];
+	pool_wg_t wg;
+	pool_t *p;
+
+	printf("main: [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	p = pool_init(4, 16);
+
+	// one future per task
+	for (intptr_t i = 0; i < TASKS; i++) {
+		pool_future_init(&futures[i]);
+		pool_submit(p, square, (void *)i, &futures[i], NULL);
+	}
+
+	for (int i = 0; i < TASKS; i++) {
+		printf("square(%d) = %ld\n", i, (intptr_t)pool_future_wait(&futures[i]));
+		pool_future_destroy(&futures[i]);
+	}
+
+	// many tasks, one wait group; more tasks than slots, so submit blocks
+	pool_wg_init(&wg);
+	for (intptr_t i = 1; i <= 1000; i++)
+		pool_submit(p, add, (void *)i, NULL, &wg);
+	pool_wg_wait(&wg);
+	pool_wg_destroy(&wg);
+
+	printf("sum 1..1000 = %ld\n", sum);
+	printf("pool stats: tasks done %ld\n", p->done_count);
+
+	pool_shutdown(p);
+
+	return 0;
+}
@@ -0,0 +1,196 @@
+#include <assert.h>
+
+#include "pool.h"
+
+// slot number that tells a worker to exit
+#define POOL_STOP -1
+
+void pool_future_init(pool_future_t *f) {
+	pthread_mutex_init(&f->lock, NULL);
+	pthread_cond_init(&f->done_cond, NULL);
+	f->done = 0;
+	f->result = NULL;
+}
+
+static void pool_future_set(pool_future_t *f, void *result) {
+	pthread_mutex_lock(&f->lock);
+	f->result = result;
+	f->done = 1;
+	pthread_cond_broadcast(&f->done_cond);
+	pthread_mutex_unlock(&f->lock);
+}
+
+void *pool_future_wait(pool_future_t *f) {
+	void *result;
+
+	pthread_mutex_lock(&f->lock);
+	while (!f->done)
+		pthread_cond_wait(&f->done_cond, &f->lock);
+	result = f->result;
+	pthread_mutex_unlock(&f->lock);
+
+	return result;
+}
+
+void pool_future_destroy(pool_future_t *f) {
+	pthread_mutex_destroy(&f->lock);
+	pthread_cond_destroy(&f->done_cond);
+}
+
+void pool_wg_init(pool_wg_t *wg) {
+	pthread_mutex_init(&wg->lock, NULL);
+	pthread_cond_init(&wg->zero, NULL);
+	wg->count = 0;
+}
+
+void pool_wg_add(pool_wg_t *wg, long n) {
+	pthread_mutex_lock(&wg->lock);
+	wg->count += n;
+	if (wg->count == 0)
+		pthread_cond_broadcast(&wg->zero);
+	pthread_mutex_unlock(&wg->lock);
+}
+
+void pool_wg_done(pool_wg_t *wg) {
+	pool_wg_add(wg, -1);
+}
+
+void pool_wg_wait(pool_wg_t *wg) {
+	pthread_mutex_lock(&wg->lock);
+	while (wg->count)
+		pthread_cond_wait(&wg->zero, &wg->lock);
+	pthread_mutex_unlock(&wg->lock);
+}
+
+void pool_wg_destroy(pool_wg_t *wg) {
+	pthread_mutex_destroy(&wg->lock);
+	pthread_cond_destroy(&wg->zero);
+}
+
+// Runs the task in slot. The task is copied out and the slot given back
+// first, so the slot is free again while the task runs.
+static void pool_run(pool_t *p, int slot) {
+	pool_task_t task;
+	void *result;
+
+	task = p->slots[slot];
+	queue_add(p->free, slot);
+
+	result = task.fn(task.arg);
+
+	if (task.future)
+		pool_future_set(task.future, result);
+	if (task.wg)
+		pool_wg_done(task.wg);
+
+	__atomic_fetch_add(&p->done_count, 1, __ATOMIC_RELAXED);
+}
+
+void *pool_worker(void *arg) {
+	pool_t *p = (pool_t *)arg;
+
+	while (1) {
+		int slot;
+
+		queue_get(p->tasks, &slot);
+		if (slot == POOL_STOP)
+			break;
+
+		pool_run(p, slot);
+	}
+
+	return NULL;
+}
+
+pool_t *pool_init(int nthreads, int max_tasks) {
+	pool_t *p;
+	int err;
+
+	p = malloc(sizeof(pool_t));
+	if (!p) {
+		printf("Cannot allocate memory for a pool\n");
+		abort();
+	}
+
+	p->slots = malloc(max_tasks * sizeof(pool_task_t));
+	p->workers = malloc(nthreads * sizeof(pthread_t));
+	if (!p->slots || !p->workers) {
+		printf("Cannot allocate memory for pool slots\n");
+		abort();
+	}
+
+	p->max_tasks = max_tasks;
+	p->nthreads = nthreads;
+	p->stopping = 0;
+	p->done_count = 0;
+
+	// the stop markers need room next to a full set of tasks
+	p->tasks = queue_init(max_tasks + nthreads);
+	p->free = queue_init(max_tasks);
+
+	for (int i = 0; i < max_tasks; i++)
+		queue_add(p->free, i);
+
+	for (int i = 0; i < nthreads; i++) {
+		err = pthread_create(&p->workers[i], NULL, pool_worker, p);
+		if (err) {
+			printf("pool_init: pthread_create() failed: %s\n", strerror(err));
+			abort();
+		}
+	}
+
+	return p;
+}
+
+void pool_submit(pool_t *p, pool_fn_t fn, void *arg, pool_future_t *future, pool_wg_t *wg) {
+	int slot;
+
+	assert(!p->stopping);
+
+	if (wg)
+		pool_wg_add(wg, 1);
+
+	// All slots taken: run queued tasks here rather than sleep on "free".
+	// If the tasks themselves submit, every worker could be asleep in here
+	// waiting for a slot only a worker would give back. With nothing
+	// queued, the slots are held for a moment by a worker or another
+	// submitter, and blocking is safe.
+	while (!queue_try_get(p->free, &slot)) {
+		int other;
+
+		if (!queue_try_get(p->tasks, &other)) {
+			queue_get(p->free, &slot);
+			break;
+		}
+
+		// stop markers only come with pool_shutdown, no submits then
+		assert(other != POOL_STOP);
+		pool_run(p, other);
+	}
+
+	p->slots[slot].fn = fn;
+	p->slots[slot].arg = arg;
+	p->slots[slot].future = future;
+	p->slots[slot].wg = wg;
+
+	queue_add(p->tasks, slot);
+}
+
+// The queue is FIFO, so the stop markers come out only after every task
+// submitted before them.
+void pool_shutdown(pool_t *p) {
+	p->stopping = 1;
+
+	for (int i = 0; i < p->nthreads; i++)
+		queue_add(p->tasks, POOL_STOP);
+
+	for (int i = 0; i < p->nthreads; i++)
+		pthread_join(p->workers[i], NULL);
+
+	queue_destroy(p->tasks);
+	queue_destroy(p->free);
+
+	free(p->workers);
+	free(p->slots);
+	free(p);
+}
@@ -0,0 +1,76 @@
+#ifndef __FITOS_POOL_H__
+#define __FITOS_POOL_H__
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "queue.h"
+
+typedef void *(*pool_fn_t)(void *arg);
+
+// Result of one task. pool_future_wait blocks until the task has run.
+typedef struct _PoolFuture {
+	pthread_mutex_t lock;
+	pthread_cond_t done_cond;
+	int done;
+	void *result;
+} pool_future_t;
+
+// Counts unfinished tasks of a group; pool_wg_wait blocks until zero.
+typedef struct _PoolWaitGroup {
+	pthread_mutex_t lock;
+	pthread_cond_t zero;
+	long count;
+} pool_wg_t;
+
+typedef struct _PoolTask {
+	pool_fn_t fn;
+	void *arg;
+	pool_future_t *future;
+	pool_wg_t *wg;
+} pool_task_t;
+
+// Fixed-size thread pool on top of the 2.2f queue. The queue only carries
+// ints, so tasks live in a slot table and the queues carry slot numbers:
+// "tasks" holds submitted slots in FIFO order and "free" the unused ones.
+// With all max_tasks slots in use pool_submit runs queued tasks itself
+// until one is free, so tasks may submit more tasks.
+typedef struct _Pool {
+	queue_t *tasks;
+	queue_t *free;
+
+	pool_task_t *slots;
+	int max_tasks;
+
+	pthread_t *workers;
+	int nthreads;
+
+	int stopping;
+	long done_count;
+} pool_t;
+
+pool_t *pool_init(int nthreads, int max_tasks);
+
+// Runs every task submitted so far, then stops the workers and frees the
+// pool. Submitting after or during the call is a bug.
+void pool_shutdown(pool_t *p);
+
+// future and wg may be NULL. A task may call it, but must not wait for
+// the tasks it submitted: with every worker waiting, nobody runs them.
+void pool_submit(pool_t *p, pool_fn_t fn, void *arg, pool_future_t *future, pool_wg_t *wg);
+
+void pool_future_init(pool_future_t *f);
+void *pool_future_wait(pool_future_t *f);
+void pool_future_destroy(pool_future_t *f);
+
+void pool_wg_init(pool_wg_t *wg);
+void pool_wg_add(pool_wg_t *wg, long n);
+void pool_wg_done(pool_wg_t *wg);
+void pool_wg_wait(pool_wg_t *wg);
+void pool_wg_destroy(pool_wg_t *wg);
+
+#endif		// __FITOS_POOL_H__
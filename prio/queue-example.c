@@ -0,0 +1,43 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include "queue.h"
+
+int main() {
+	queue_t *q;
+
+	printf("main: [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	q = queue_init(1000);
+
+	// bulk items, then every third one is urgent
+	for (int i = 0; i < 10; i++) {
+		int prio = i % 3 == 2 ? 10 : QUEUE_PRIO_DEFAULT;
+		int ok = queue_add_prio(q, i, prio);
+
+		printf("ok %d: add value %d prio %d\n", ok, i, prio);
+	}
+
+	queue_print_stats(q);
+
+	// expected: 2 5 8, then 0 1 3 4 6 7 9
+	for (int i = 0; i < 10; i++) {
+		int val = -1;
+		int ok = queue_get(q, &val);
+
+		printf("ok: %d: get value %d\n", ok, val);
+	}
+
+	queue_print_stats(q);
+
+	queue_destroy(q);
+
+	return 0;
+}
@@ -0,0 +1,174 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+
+#include "queue.h"
+
+#define LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+
+queue_t* queue_init(int max_count) {
+    int err;
+    queue_t *q;
+
+    err = posix_memalign((void **)&q, CACHE_LINE_SIZE, sizeof(queue_t));
+    if (err) {
+        printf("Cannot allocate memory for a queue\n");
+        abort();
+    }
+
+    q->max_count = max_count;
+    q->nonempty = 0;
+
+    for (int p = 0; p < QUEUE_PRIOS; p++) {
+        qlevel_t *level = &q->levels[p];
+
+        level->first = level->last = NULL;
+        level->add_count = level->get_count = 0;
+
+        err = pthread_mutex_init(&level->lock, NULL);
+        if (err) {
+            printf("queue_init: pthread_mutex_init (prio %d) failed: %s\n", p, strerror(err));
+            abort();
+        }
+    }
+
+    err = sem_init(&q->empty, 0, max_count);
+    if (err) {
+        printf("queue_init: sem_init (empty) failed\n");
+        abort();
+    }
+
+    err = sem_init(&q->full, 0, 0);
+    if (err) {
+        printf("queue_init: sem_init (full) failed\n");
+        abort();
+    }
+
+    return q;
+}
+
+void queue_destroy(queue_t *q) {
+    if (q == NULL) return;
+
+    sem_destroy(&q->empty);
+    sem_destroy(&q->full);
+
+    for (int p = 0; p < QUEUE_PRIOS; p++) {
+        qlevel_t *level = &q->levels[p];
+        qnode_t *current = level->first;
+
+        while (current != NULL) {
+            qnode_t *temp = current;
+            current = current->next;
+            free(temp);
+        }
+
+        pthread_mutex_destroy(&level->lock);
+    }
+
+    free(q);
+}
+
+int queue_add_prio(queue_t *q, int val, int prio) {
+    qlevel_t *level;
+    qnode_t *new;
+
+    if (prio < 0)
+        prio = 0;
+    if (prio >= QUEUE_PRIOS)
+        prio = QUEUE_PRIOS - 1;
+
+    level = &q->levels[prio];
+
+    new = malloc(sizeof(qnode_t));
+    if (!new) {
+        printf("Cannot allocate memory for new node\n");
+        abort();
+    }
+
+    new->val = val;
+    new->next = NULL;
+
+    sem_wait(&q->empty);
+
+    pthread_mutex_lock(&level->lock);
+
+    if (!level->first) {
+        level->first = level->last = new;
+        __atomic_fetch_or(&q->nonempty, 1ull << prio, __ATOMIC_RELEASE);
+    } else {
+        level->last->next = new;
+        level->last = new;
+    }
+
+    level->add_count++;
+
+    pthread_mutex_unlock(&level->lock);
+    sem_post(&q->full);
+    return 1;
+}
+
+int queue_add(queue_t *q, int val) {
+    return queue_add_prio(q, val, QUEUE_PRIO_DEFAULT);
+}
+
+// The token taken from full reserves one item somewhere, and a level's bit
+// is set before its items are posted, so the bitmap is never empty here.
+// Another reader may still empty the chosen level first; then look again.
+int queue_get(queue_t *q, int *val) {
+    qnode_t *tmp = NULL;
+
+    sem_wait(&q->full);
+
+    while (!tmp) {
+        uint64_t mask = LOAD(&q->nonempty);
+        qlevel_t *level;
+        int prio;
+
+        if (!mask)
+            continue;
+
+        prio = 63 - __builtin_clzll(mask);
+        level = &q->levels[prio];
+
+        pthread_mutex_lock(&level->lock);
+
+        tmp = level->first;
+        if (tmp) {
+            level->first = tmp->next;
+            if (!level->first) {
+                level->last = NULL;
+                __atomic_fetch_and(&q->nonempty, ~(1ull << prio), __ATOMIC_RELEASE);
+            }
+
+            level->get_count++;
+        }
+
+        pthread_mutex_unlock(&level->lock);
+    }
+
+    sem_post(&q->empty);
+
+    *val = tmp->val;
+    free(tmp);
+    return 1;
+}
+
+void queue_print_stats(queue_t *q) {
+	long add_count = 0, get_count = 0;
+
+	for (int p = QUEUE_PRIOS - 1; p >= 0; p--) {
+		qlevel_t *level = &q->levels[p];
+
+		pthread_mutex_lock(&level->lock);
+		if (level->add_count)
+			printf("prio %d: counts (%ld %ld %ld)\n", p,
+				level->add_count, level->get_count,
+				level->add_count - level->get_count);
+		add_count += level->add_count;
+		get_count += level->get_count;
+		pthread_mutex_unlock(&level->lock);
+	}
+
+	printf("queue stats: counts (%ld %ld %ld)\n",
+		add_count, get_count, add_count - get_count);
+}
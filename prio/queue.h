@@ -0,0 +1,61 @@
+#ifndef __FITOS_QUEUE_H__
+#define __FITOS_QUEUE_H__
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#define CACHE_LINE_SIZE 64
+
+// Priorities are 0 (bulk) .. QUEUE_PRIOS - 1 (most urgent)
+#define QUEUE_PRIOS 64
+#define QUEUE_PRIO_DEFAULT 0
+
+typedef struct _QueueNode {
+	int val;
+	struct _QueueNode *next;
+} qnode_t;
+
+// All items of one priority, FIFO, under their own lock.
+typedef struct _QueueLevel {
+	pthread_mutex_t lock;
+	qnode_t *first;
+	qnode_t *last;
+
+	long add_count;
+	long get_count;
+} __attribute__((aligned(CACHE_LINE_SIZE))) qlevel_t;
+
+// Bounded blocking priority queue. queue_get returns the oldest item of
+// the most urgent non-empty priority. Levels are locked separately, so
+// threads working on different priorities do not contend; the only shared
+// word besides the semaphores is the bitmap of non-empty levels.
+typedef struct _Queue {
+	sem_t empty __attribute__((aligned(CACHE_LINE_SIZE)));
+	sem_t full __attribute__((aligned(CACHE_LINE_SIZE)));
+
+	// bit p is set while level p has items; changed under that level's lock
+	uint64_t nonempty __attribute__((aligned(CACHE_LINE_SIZE)));
+
+	int max_count __attribute__((aligned(CACHE_LINE_SIZE)));
+
+	qlevel_t levels[QUEUE_PRIOS];
+} queue_t;
+
+queue_t* queue_init(int max_count);
+void queue_destroy(queue_t *q);
+
+// prio is clamped to 0 .. QUEUE_PRIOS - 1
+int queue_add_prio(queue_t *q, int val, int prio);
+int queue_add(queue_t *q, int val);		// QUEUE_PRIO_DEFAULT
+int queue_get(queue_t *q, int *val);
+void queue_print_stats(queue_t *q);
+
+#endif		// __FITOS_QUEUE_H__
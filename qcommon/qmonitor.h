@@ -0,0 +1,8 @@
+#ifndef __FITOS_QMONITOR_H__
+#define __FITOS_QMONITOR_H__
+
+// Set to start a thread that prints the queue stats once a second.
+// Separate from QUEUE_TELEMETRY, which names the 2.2f/2.2g histogram file.
+#define QMONITOR_ENV "QUEUE_MONITOR"
+
+#endif		// __FITOS_QMONITOR_H__
@@ -0,0 +1,173 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+
+// queue.h is the one of the variant being built: 2.2f and 2.2g
+// compile this file with their own directory first on the include path.
+#include "queue.h"
+#include "qpool.h"
+
+// Called with pool->lock held (or before the pool is shared).
+static int qpool_grow(qpool_t *pool, int count) {
+	qchunk_t *chunk = malloc(sizeof(qchunk_t));
+	if (!chunk)
+		return ENOMEM;
+
+	chunk->nodes = malloc(count * sizeof(qnode_t));
+	if (!chunk->nodes) {
+		free(chunk);
+		return ENOMEM;
+	}
+
+	for (int i = 0; i < count; i++) {
+		chunk->nodes[i].next = pool->free;
+		pool->free = &chunk->nodes[i];
+	}
+
+	chunk->next = pool->chunks;
+	pool->chunks = chunk;
+
+	return 0;
+}
+
+static void qpool_flush(qcache_t *cache, int count) {
+	qpool_t *pool = cache->pool;
+
+	pthread_mutex_lock(&pool->lock);
+
+	while (count-- > 0 && cache->free) {
+		qnode_t *node = cache->free;
+
+		cache->free = node->next;
+		cache->count--;
+
+		node->next = pool->free;
+		pool->free = node;
+	}
+
+	pthread_mutex_unlock(&pool->lock);
+}
+
+// Thread exit: give the cached nodes back so other threads can use them.
+static void qpool_cache_release(void *arg) {
+	qcache_t *cache = (qcache_t *)arg;
+
+	qpool_flush(cache, cache->count);
+}
+
+static qcache_t *qpool_cache(qpool_t *pool) {
+	qcache_t *cache = pthread_getspecific(pool->key);
+	if (cache)
+		return cache;
+
+	cache = malloc(sizeof(qcache_t));
+	if (!cache) {
+		printf("Cannot allocate memory for a node cache\n");
+		abort();
+	}
+
+	cache->free = NULL;
+	cache->count = 0;
+	cache->pool = pool;
+
+	pthread_mutex_lock(&pool->lock);
+	cache->next = pool->caches;
+	pool->caches = cache;
+	pthread_mutex_unlock(&pool->lock);
+
+	pthread_setspecific(pool->key, cache);
+
+	return cache;
+}
+
+int qpool_init(qpool_t *pool, int count) {
+	int err;
+
+	pool->free = NULL;
+	pool->chunks = NULL;
+	pool->caches = NULL;
+
+	err = pthread_mutex_init(&pool->lock, NULL);
+	if (err)
+		return err;
+
+	err = pthread_key_create(&pool->key, qpool_cache_release);
+	if (err) {
+		pthread_mutex_destroy(&pool->lock);
+		return err;
+	}
+
+	err = qpool_grow(pool, count);
+	if (err) {
+		pthread_key_delete(pool->key);
+		pthread_mutex_destroy(&pool->lock);
+		return err;
+	}
+
+	return 0;
+}
+
+// No thread may use the pool anymore. Deleting the key also keeps thread
+// exit from touching the freed caches.
+void qpool_destroy(qpool_t *pool) {
+	pthread_key_delete(pool->key);
+
+	while (pool->caches) {
+		qcache_t *cache = pool->caches;
+		pool->caches = cache->next;
+		free(cache);
+	}
+
+	while (pool->chunks) {
+		qchunk_t *chunk = pool->chunks;
+		pool->chunks = chunk->next;
+		free(chunk->nodes);
+		free(chunk);
+	}
+
+	pthread_mutex_destroy(&pool->lock);
+}
+
+qnode_t *qpool_alloc(qpool_t *pool) {
+	qcache_t *cache = qpool_cache(pool);
+	qnode_t *node;
+
+	if (!cache->free) {
+		pthread_mutex_lock(&pool->lock);
+
+		// Nodes parked in other threads' caches are out of reach, so the
+		// pool may run dry even below max_count: add one more batch.
+		if (!pool->free && qpool_grow(pool, QPOOL_BATCH)) {
+			pthread_mutex_unlock(&pool->lock);
+			printf("Cannot allocate memory for new nodes\n");
+			abort();
+		}
+
+		while (cache->count < QPOOL_BATCH && pool->free) {
+			node = pool->free;
+			pool->free = node->next;
+
+			node->next = cache->free;
+			cache->free = node;
+			cache->count++;
+		}
+
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	node = cache->free;
+	cache->free = node->next;
+	cache->count--;
+
+	return node;
+}
+
+void qpool_free(qpool_t *pool, qnode_t *node) {
+	qcache_t *cache = qpool_cache(pool);
+
+	node->next = cache->free;
+	cache->free = node;
+	cache->count++;
+
+	if (cache->count >= 2 * QPOOL_BATCH)
+		qpool_flush(cache, QPOOL_BATCH);
+}
@@ -0,0 +1,43 @@
+#ifndef __FITOS_QPOOL_H__
+#define __FITOS_QPOOL_H__
+
+#include <pthread.h>
+
+// Nodes moved between a thread cache and the shared free list at once.
+#define QPOOL_BATCH 32
+
+struct _QueueNode;
+
+typedef struct _QueueChunk {
+	struct _QueueNode *nodes;
+	struct _QueueChunk *next;
+} qchunk_t;
+
+// Per-thread stash of free nodes, so most qpool_alloc/qpool_free calls
+// take no lock at all.
+typedef struct _QueueCache {
+	struct _QueueNode *free;
+	int count;
+	struct _QueuePool *pool;
+	struct _QueueCache *next;
+} qcache_t;
+
+// Fixed-size node allocator for one queue. Nodes come from chunks carved
+// out at qpool_init and are only returned to malloc by qpool_destroy.
+typedef struct _QueuePool {
+	pthread_mutex_t lock;
+
+	// protected by lock
+	struct _QueueNode *free;
+	qchunk_t *chunks;
+	qcache_t *caches;
+
+	pthread_key_t key;
+} qpool_t;
+
+int qpool_init(qpool_t *pool, int count);
+void qpool_destroy(qpool_t *pool);
+struct _QueueNode *qpool_alloc(qpool_t *pool);
+void qpool_free(qpool_t *pool, struct _QueueNode *node);
+
+#endif		// __FITOS_QPOOL_H__
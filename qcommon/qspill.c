@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "qspill.h"
+
+static size_t qseg_size(const qspill_t *s) {
+	return (size_t)s->seg_items * sizeof(int);
+}
+
+static void qseg_map(qspill_t *s, qseg_t *seg) {
+	if (seg->items)
+		return;
+
+	seg->items = mmap(NULL, qseg_size(s), PROT_READ | PROT_WRITE, MAP_SHARED, seg->fd, 0);
+	if (seg->items == MAP_FAILED) {
+		printf("qspill: mmap failed: %s\n", strerror(errno));
+		abort();
+	}
+}
+
+static void qseg_unmap(qspill_t *s, qseg_t *seg) {
+	if (!seg->items)
+		return;
+
+	munmap(seg->items, qseg_size(s));
+	seg->items = NULL;
+}
+
+// Creates a segment file with all its blocks allocated up front, so
+// writing through the mapping can never hit a full disk (a sparse file
+// would SIGBUS there). Touches nothing but dir and seg_items, which do
+// not change, so it runs without the queue lock.
+static int qseg_create(const qspill_t *s, qseg_t **out) {
+	char path[sizeof(s->dir) + 32];
+	qseg_t *seg;
+	int err;
+
+	seg = malloc(sizeof(qseg_t));
+	if (!seg) {
+		printf("Cannot allocate memory for a spill segment\n");
+		abort();
+	}
+
+	snprintf(path, sizeof(path), "%s/qspill-XXXXXX", s->dir);
+
+	seg->fd = mkstemp(path);
+	if (seg->fd < 0) {
+		err = errno;
+		free(seg);
+		return err;
+	}
+
+	unlink(path);
+
+	err = posix_fallocate(seg->fd, 0, qseg_size(s));
+	if (err) {
+		close(seg->fd);
+		free(seg);
+		return err;
+	}
+
+	seg->items = NULL;
+	seg->next = NULL;
+
+	*out = seg;
+	return 0;
+}
+
+// A segment for the tail: a spare one, or NULL if a new file is needed.
+static qseg_t *qseg_get(qspill_t *s) {
+	qseg_t *seg = s->spare;
+
+	if (!seg)
+		return NULL;
+
+	s->spare = seg->next;
+	s->nspare--;
+
+	seg->next = NULL;
+	return seg;
+}
+
+static void qseg_free(qspill_t *s, qseg_t *seg) {
+	qseg_unmap(s, seg);
+
+	if (s->nspare < QSPILL_SPARES) {
+		seg->next = s->spare;
+		s->spare = seg;
+		s->nspare++;
+		s->recycled++;
+		return;
+	}
+
+	close(seg->fd);
+	free(seg);
+}
+
+int qspill_init(qspill_t *s, const char *dir, int seg_items) {
+	if (!dir || strlen(dir) >= sizeof(s->dir) || seg_items <= 0)
+		return EINVAL;
+
+	if (access(dir, W_OK))
+		return errno;
+
+	strcpy(s->dir, dir);
+	s->seg_items = seg_items;
+
+	s->head = s->tail = NULL;
+	s->read_pos = s->write_pos = 0;
+	s->count = 0;
+
+	s->spare = NULL;
+	s->nspare = 0;
+
+	s->spilled = s->replayed = 0;
+	s->segments = s->recycled = 0;
+	s->failed = 0;
+
+	return 0;
+}
+
+void qspill_destroy(qspill_t *s) {
+	while (s->head) {
+		qseg_t *seg = s->head;
+		s->head = seg->next;
+
+		qseg_unmap(s, seg);
+		close(seg->fd);
+		free(seg);
+	}
+
+	while (s->spare) {
+		qseg_t *seg = s->spare;
+		s->spare = seg->next;
+
+		close(seg->fd);
+		free(seg);
+	}
+
+	s->tail = NULL;
+	s->count = 0;
+}
+
+// Appends val, 0 on success. Only ever takes a spare segment; if a new
+// one is needed and there is none, returns EAGAIN and the caller makes one.
+static int qspill_push(qspill_t *s, int val) {
+	qseg_t *seg;
+
+	if (!s->tail) {
+		seg = qseg_get(s);
+		if (!seg)
+			return EAGAIN;
+
+		s->head = s->tail = seg;
+		s->read_pos = s->write_pos = 0;
+	} else if (s->write_pos == s->seg_items) {
+		seg = qseg_get(s);
+		if (!seg)
+			return EAGAIN;
+
+		// a full segment in the middle is only needed again when read
+		if (s->tail != s->head)
+			qseg_unmap(s, s->tail);
+
+		s->tail->next = seg;
+		s->tail = seg;
+		s->write_pos = 0;
+	}
+
+	qseg_map(s, s->tail);
+	s->tail->items[s->write_pos++] = val;
+
+	s->count++;
+	s->spilled++;
+
+	return 0;
+}
+
+int qspill_push_n(qspill_t *s, pthread_mutex_t *lock, const int *vals, int n) {
+	qseg_t *seg;
+	int k = 0, err;
+
+	while (k < n) {
+		if (!qspill_push(s, vals[k])) {
+			k++;
+			continue;
+		}
+
+		pthread_mutex_unlock(lock);
+		err = qseg_create(s, &seg);
+		pthread_mutex_lock(lock);
+
+		if (err) {
+			s->failed++;
+			break;
+		}
+
+		// a spare: whoever needs a segment next takes it, maybe not us
+		seg->next = s->spare;
+		s->spare = seg;
+		s->nspare++;
+		s->segments++;
+	}
+
+	return k;
+}
+
+int qspill_pop(qspill_t *s, int *val) {
+	if (!s->count)
+		return 0;
+
+	if (s->read_pos == s->seg_items) {
+		qseg_t *seg = s->head;
+
+		s->head = seg->next;
+		s->read_pos = 0;
+		qseg_free(s, seg);
+	}
+
+	qseg_map(s, s->head);
+	*val = s->head->items[s->read_pos++];
+
+	s->count--;
+	s->replayed++;
+
+	// drained: start over at the beginning of the same segment
+	if (!s->count)
+		s->read_pos = s->write_pos = 0;
+
+	return 1;
+}
@@ -0,0 +1,56 @@
+#ifndef __FITOS_QSPILL_H__
+#define __FITOS_QSPILL_H__
+
+#include <pthread.h>
+
+// Items per segment file by default (4 MB of ints)
+#define QSPILL_SEGMENT_ITEMS (1 << 20)
+// Drained segments kept for reuse instead of being dropped
+#define QSPILL_SPARES 2
+
+// One segment file. Files are unlinked right after creation, so they
+// vanish with the process; only the fd keeps them alive. Their blocks are
+// allocated when they are created.
+typedef struct _SpillSegment {
+	int fd;
+	int *items;		// mapping, NULL while not mapped
+	struct _SpillSegment *next;
+} qseg_t;
+
+// FIFO of ints on disk: a list of segments written at the tail and read
+// at the head. Only the head and tail segments are mapped, so memory use
+// does not grow with the backlog. Not thread safe; the queue lock
+// protects it.
+typedef struct _Spill {
+	char dir[256];
+	int seg_items;
+
+	qseg_t *head;
+	qseg_t *tail;
+	int read_pos;		// in head
+	int write_pos;		// in tail
+	long count;
+
+	qseg_t *spare;
+	int nspare;
+
+	// statistics
+	long spilled;
+	long replayed;
+	long segments;		// files created
+	long recycled;		// drained segments reused
+	long failed;		// files that could not be created, disk full
+} qspill_t;
+
+int qspill_init(qspill_t *s, const char *dir, int seg_items);
+void qspill_destroy(qspill_t *s);
+
+// Appends vals in order, called with lock held. When a new segment file
+// is needed the lock is dropped while it is created, so the caller must
+// not rely on state it read before. Returns how many were appended:
+// fewer than n only if a file could not be created, e.g. the disk is
+// full, and then the rest is the caller's to keep in memory.
+int qspill_push_n(qspill_t *s, pthread_mutex_t *lock, const int *vals, int n);
+int qspill_pop(qspill_t *s, int *val);
+
+#endif		// __FITOS_QSPILL_H__
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "qtelemetry.h"
+
+// Samples a stats file published by a queue with QUEUE_TELEMETRY=<prefix>
+// (<prefix>.<pid>.<n>) and prints what happened since the previous sample:
+//
+//	qstat <file> [interval_s]
+
+// Upper bound of bucket b.
+static uint64_t bucket_max(int b) {
+	return b ? (1ull << b) - 1 : 0;
+}
+
+static uint64_t percentile(const uint64_t *delta, uint64_t total, double p) {
+	uint64_t rank = total * p, seen = 0;
+
+	for (int b = 0; b < QTM_BUCKETS; b++) {
+		seen += delta[b];
+		if (seen > rank)
+			return bucket_max(b);
+	}
+
+	return bucket_max(QTM_BUCKETS - 1);
+}
+
+static void print_hist(const char *name, const qtm_hist_t *h, qtm_hist_t *prev) {
+	uint64_t delta[QTM_BUCKETS], total = 0, zero;
+	int top = 0;
+
+	for (int b = 0; b < QTM_BUCKETS; b++) {
+		uint64_t v = __atomic_load_n(&h->bucket[b], __ATOMIC_RELAXED);
+
+		delta[b] = v - prev->bucket[b];
+		prev->bucket[b] = v;
+
+		total += delta[b];
+		if (delta[b])
+			top = b;
+	}
+
+	zero = delta[0];
+	if (!total) {
+		printf("  %-9s -\n", name);
+		return;
+	}
+
+	printf("  %-9s n %-10lu zero %5.1f%%  p50 <=%-10lu p99 <=%-10lu max <=%lu\n",
+		name, total, 100.0 * zero / total,
+		percentile(delta, total, 0.50), percentile(delta, total, 0.99),
+		bucket_max(top));
+}
+
+int main(int argc, char **argv) {
+	qtm_hist_t prev[4];
+	const qtm_t *tm;
+	struct stat st;
+	int interval = 1;
+	int fd;
+
+	if (argc < 2) {
+		printf("usage: %s <file> [interval_s]\n", argv[0]);
+		return 1;
+	}
+
+	if (argc > 2)
+		interval = atoi(argv[2]);
+
+	fd = open(argv[1], O_RDONLY);
+	if (fd < 0) {
+		printf("qstat: open(%s) failed: %s\n", argv[1], strerror(errno));
+		return 1;
+	}
+
+	// mapping past the end of a short file would SIGBUS on the first read
+	if (fstat(fd, &st)) {
+		printf("qstat: fstat(%s) failed: %s\n", argv[1], strerror(errno));
+		close(fd);
+		return 1;
+	}
+
+	if (st.st_size < (off_t)sizeof(qtm_t)) {
+		printf("qstat: %s is not a queue stats file\n", argv[1]);
+		close(fd);
+		return 1;
+	}
+
+	tm = mmap(NULL, sizeof(qtm_t), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (tm == MAP_FAILED) {
+		printf("qstat: mmap(%s) failed: %s\n", argv[1], strerror(errno));
+		return 1;
+	}
+
+	if (__atomic_load_n(&tm->magic, __ATOMIC_ACQUIRE) != QTM_MAGIC) {
+		printf("qstat: %s is not a queue stats file\n", argv[1]);
+		return 1;
+	}
+
+	memset(prev, 0, sizeof(prev));
+
+	while (1) {
+		printf("queue of pid %d, max_count %d:\n", tm->pid, tm->max_count);
+		print_hist("add depth", &tm->add_depth, &prev[0]);
+		print_hist("get depth", &tm->get_depth, &prev[1]);
+		print_hist("add ns", &tm->add_wait, &prev[2]);
+		print_hist("get ns", &tm->get_wait, &prev[3]);
+		fflush(stdout);
+
+		sleep(interval);
+	}
+
+	return 0;
+}
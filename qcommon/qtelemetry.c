@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "qtelemetry.h"
+
+// Telemetry is a diagnostic: if the file cannot be set up the queue works
+// without it, so errors are reported and NULL is returned.
+qtm_t *qtm_open(const char *prefix, int max_count) {
+	static int next_index;
+	char path[4096];
+	qtm_t *tm;
+	int fd;
+
+	// one file per queue: queues of one process, or of processes that
+	// inherited the same prefix, would overwrite each other's histograms
+	snprintf(path, sizeof(path), "%s.%d.%d", prefix, (int)getpid(),
+		__atomic_fetch_add(&next_index, 1, __ATOMIC_RELAXED));
+
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		printf("qtm_open: open(%s) failed: %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	if (ftruncate(fd, sizeof(qtm_t))) {
+		printf("qtm_open: ftruncate(%s) failed: %s\n", path, strerror(errno));
+		close(fd);
+		return NULL;
+	}
+
+	tm = mmap(NULL, sizeof(qtm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (tm == MAP_FAILED) {
+		printf("qtm_open: mmap(%s) failed: %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	// the file is zero filled by ftruncate; magic goes last so a sampler
+	// never accepts a half initialized header
+	tm->pid = getpid();
+	tm->max_count = max_count;
+	__atomic_store_n(&tm->magic, QTM_MAGIC, __ATOMIC_RELEASE);
+
+	return tm;
+}
+
+// The file stays behind for post mortem sampling.
+void qtm_close(qtm_t *tm) {
+	if (tm)
+		munmap(tm, sizeof(qtm_t));
+}
@@ -0,0 +1,69 @@
+#ifndef __FITOS_QTELEMETRY_H__
+#define __FITOS_QTELEMETRY_H__
+
+#include <stdint.h>
+#include <time.h>
+
+#define QTM_MAGIC 0x314d5451	// "QTM1"
+#define QTM_BUCKETS 32
+
+#define QTM_CACHE_LINE_SIZE 64
+
+// Power of two histogram: bucket 0 counts zeros, bucket i counts values
+// in [2^(i-1), 2^i). The last bucket also takes everything above.
+typedef struct _QueueHist {
+	uint64_t bucket[QTM_BUCKETS];
+} __attribute__((aligned(QTM_CACHE_LINE_SIZE))) qtm_hist_t;
+
+// Layout of the stats file. Writers only ever add to the buckets with
+// relaxed atomics, so a sampler can read the file at any time; it sees
+// each counter either before or after an update, never torn.
+typedef struct _QueueTelemetry {
+	uint32_t magic;
+	int32_t pid;
+	int32_t max_count;
+
+	// queue depth right after each add / get
+	qtm_hist_t add_depth;
+	qtm_hist_t get_depth;
+
+	// nanoseconds add / get spent blocked, 0 when it did not block
+	qtm_hist_t add_wait;
+	qtm_hist_t get_wait;
+} qtm_t;
+
+// Name of the environment variable that enables telemetry. Each queue_init
+// publishes its stats to <value>.<pid>.<n>, n counting the queues of the
+// process from 0.
+#define QTM_ENV "QUEUE_TELEMETRY"
+
+qtm_t *qtm_open(const char *prefix, int max_count);
+void qtm_close(qtm_t *tm);
+
+static inline int qtm_bucket(uint64_t v) {
+	int b = v ? 64 - __builtin_clzll(v) : 0;
+	return b < QTM_BUCKETS ? b : QTM_BUCKETS - 1;
+}
+
+static inline void qtm_record(qtm_hist_t *h, uint64_t v) {
+	__atomic_fetch_add(&h->bucket[qtm_bucket(v)], 1, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t qtm_now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline void qtm_on_add(qtm_t *tm, uint64_t wait_ns, int depth) {
+	qtm_record(&tm->add_wait, wait_ns);
+	qtm_record(&tm->add_depth, depth);
+}
+
+static inline void qtm_on_get(qtm_t *tm, uint64_t wait_ns, int depth) {
+	qtm_record(&tm->get_wait, wait_ns);
+	qtm_record(&tm->get_depth, depth);
+}
+
+#endif		// __FITOS_QTELEMETRY_H__
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "qtrace.h"
+
+uint64_t qhdr_bucket_max(int b) {
+	int shift;
+
+	if (b < (1 << QHDR_SUB_BITS))
+		return b;
+
+	shift = b / QHDR_HALF - 1;
+	return ((uint64_t)(b - shift * QHDR_HALF + 1) << shift) - 1;
+}
+
+uint64_t qhdr_percentile(const uint64_t *counts, uint64_t total, double p) {
+	uint64_t rank = total * p, seen = 0;
+
+	for (int b = 0; b < QHDR_BUCKETS; b++) {
+		seen += counts[b];
+		if (seen > rank)
+			return qhdr_bucket_max(b);
+	}
+
+	return qhdr_bucket_max(QHDR_BUCKETS - 1);
+}
+
+// Prints the items counted in cur but not yet in prev (NULL: all of them)
+// and moves prev up to cur.
+static void qtrace_report(const char *what, qtrace_t *t, uint64_t *prev) {
+	uint64_t *delta = t->delta;
+	uint64_t max = __atomic_load_n(&t->hist.max, __ATOMIC_RELAXED);
+	uint64_t total = 0, pct[3];
+	double ps[3] = { 0.50, 0.99, 0.999 };
+
+	for (int b = 0; b < QHDR_BUCKETS; b++) {
+		uint64_t v = __atomic_load_n(&t->hist.count[b], __ATOMIC_RELAXED);
+
+		delta[b] = prev ? v - prev[b] : v;
+		if (prev)
+			prev[b] = v;
+		total += delta[b];
+	}
+
+	if (!total) {
+		printf("queue %d latency (%s): no items\n", t->id, what);
+		return;
+	}
+
+	// a bucket bound can lie above the largest value actually seen
+	for (int i = 0; i < 3; i++) {
+		pct[i] = qhdr_percentile(delta, total, ps[i]);
+		if (pct[i] > max)
+			pct[i] = max;
+	}
+
+	printf("queue %d latency (%s): n %lu; p50 %lu ns; p99 %lu ns; p99.9 %lu ns; max %lu ns\n",
+		t->id, what, total, pct[0], pct[1], pct[2], max);
+	fflush(stdout);
+}
+
+// Per interval percentiles; max is for the whole run.
+static void *qtrace_reporter(void *arg) {
+	qtrace_t *t = (qtrace_t *)arg;
+	uint64_t *prev = calloc(QHDR_BUCKETS, sizeof(uint64_t));
+	struct timespec ts;
+	char what[32];
+
+	if (!prev) {
+		printf("Cannot allocate memory for the trace reporter\n");
+		abort();
+	}
+
+	snprintf(what, sizeof(what), "last %d s", t->interval);
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	pthread_mutex_lock(&t->lock);
+	while (!t->stop) {
+		ts.tv_sec += t->interval;
+		if (pthread_cond_timedwait(&t->wake, &t->lock, &ts) == ETIMEDOUT)
+			qtrace_report(what, t, prev);
+	}
+	pthread_mutex_unlock(&t->lock);
+
+	free(prev);
+	return NULL;
+}
+
+qtrace_t *qtrace_open(void) {
+	static int next_id;
+	const char *env = getenv(QTRACE_ENV);
+	qtrace_t *t;
+	int err;
+
+	if (!env)
+		return NULL;
+
+	if (!QTRACE) {
+		printf("qtrace: %s ignored, items carry no stamp; rebuild with QTRACE=1\n", QTRACE_ENV);
+		return NULL;
+	}
+
+	err = posix_memalign((void **)&t, QTM_CACHE_LINE_SIZE, sizeof(qtrace_t));
+	if (err) {
+		printf("Cannot allocate memory for queue tracing\n");
+		abort();
+	}
+
+	memset(&t->hist, 0, sizeof(t->hist));
+	t->id = __atomic_fetch_add(&next_id, 1, __ATOMIC_RELAXED);
+	t->interval = atoi(env);
+	t->stop = 0;
+
+	pthread_mutex_init(&t->lock, NULL);
+	pthread_cond_init(&t->wake, NULL);
+
+	if (t->interval > 0) {
+		err = pthread_create(&t->tid, NULL, qtrace_reporter, t);
+		if (err) {
+			printf("qtrace_open: pthread_create() failed: %s\n", strerror(err));
+			abort();
+		}
+	}
+
+	return t;
+}
+
+void qtrace_close(qtrace_t *t) {
+	if (!t)
+		return;
+
+	if (t->interval > 0) {
+		pthread_mutex_lock(&t->lock);
+		t->stop = 1;
+		pthread_cond_signal(&t->wake);
+		pthread_mutex_unlock(&t->lock);
+
+		pthread_join(t->tid, NULL);
+	}
+
+	qtrace_report("total", t, NULL);
+
+	pthread_mutex_destroy(&t->lock);
+	pthread_cond_destroy(&t->wake);
+	free(t);
+}
@@ -0,0 +1,103 @@
+#ifndef __FITOS_QTRACE_H__
+#define __FITOS_QTRACE_H__
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "qtelemetry.h"
+
+// Name of the environment variable that enables tracing: every item is
+// stamped on add, and the time it spent in the queue is recorded on get.
+// The value is the report interval in seconds; 0 reports only when the
+// queue is destroyed.
+#define QTRACE_ENV "QUEUE_TRACE"
+
+// The stamp costs 8 bytes in every queue node, so it is only there when
+// built with -DQTRACE=1 (make QTRACE=1); otherwise QTRACE_ENV is ignored.
+#ifndef QTRACE
+#define QTRACE 0
+#endif
+
+#if QTRACE
+#define QTRACE_STAMP(node, now) ((node)->stamp = (now))
+#define QTRACE_RECORD(t, node, now) qtrace_record((t), (node)->stamp, (now))
+#else
+#define QTRACE_STAMP(node, now) ((void)(now))
+#define QTRACE_RECORD(t, node, now) ((void)(now))
+#endif
+
+// Log-linear (HDR) buckets: values below 2^QHDR_SUB_BITS are exact,
+// every power of two above is split into 2^(QHDR_SUB_BITS - 1) buckets,
+// so any value is off by less than 1/64. Values from 2^QHDR_MAX_BITS ns
+// (about 18 minutes) up land in the last bucket.
+#define QHDR_SUB_BITS 7
+#define QHDR_MAX_BITS 40
+#define QHDR_HALF (1 << (QHDR_SUB_BITS - 1))
+#define QHDR_BUCKETS ((QHDR_MAX_BITS - QHDR_SUB_BITS + 2) * QHDR_HALF)
+
+// Recording is a relaxed fetch_add, plus a CAS loop when a new maximum
+// is seen; readers get a consistent enough picture without stopping it.
+typedef struct _QueueHdr {
+	uint64_t count[QHDR_BUCKETS];
+	uint64_t max;
+} __attribute__((aligned(QTM_CACHE_LINE_SIZE))) qhdr_t;
+
+typedef struct _QueueTrace {
+	qhdr_t hist;
+
+	// numbers the traced queues of the process from 0, for the reports
+	int id;
+
+	// scratch of qtrace_report; the reporter thread and qtrace_close
+	// never run it at the same time
+	uint64_t delta[QHDR_BUCKETS];
+
+	// periodic reporter, only running when interval > 0
+	int interval;
+	pthread_t tid;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	int stop;
+} qtrace_t;
+
+static inline int qhdr_bucket(uint64_t v) {
+	int shift;
+
+	if (v < (1u << QHDR_SUB_BITS))
+		return v;
+
+	if (v >> QHDR_MAX_BITS)
+		return QHDR_BUCKETS - 1;
+
+	// msb - (QHDR_SUB_BITS - 1) leaves v >> shift in [HALF, 2 * HALF)
+	shift = 63 - __builtin_clzll(v) - (QHDR_SUB_BITS - 1);
+	return shift * QHDR_HALF + (v >> shift);
+}
+
+static inline void qhdr_record(qhdr_t *h, uint64_t v) {
+	uint64_t max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+
+	__atomic_fetch_add(&h->count[qhdr_bucket(v)], 1, __ATOMIC_RELAXED);
+
+	while (v > max && !__atomic_compare_exchange_n(&h->max, &max, v, 1,
+						       __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+// Highest value that falls into bucket b.
+uint64_t qhdr_bucket_max(int b);
+
+// p in [0, 1] of the histogram in counts[] (total items).
+uint64_t qhdr_percentile(const uint64_t *counts, uint64_t total, double p);
+
+// NULL if tracing is off (QTRACE_ENV unset or built without QTRACE).
+qtrace_t *qtrace_open(void);
+
+// Stops the reporter, prints the report for the whole run and frees t.
+void qtrace_close(qtrace_t *t);
+
+static inline void qtrace_record(qtrace_t *t, uint64_t stamp, uint64_t now) {
+	qhdr_record(&t->hist, now - stamp);
+}
+
+#endif		// __FITOS_QTRACE_H__
@@ -0,0 +1,88 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "queue.h"
+
+#define RED "\033[41m"
+#define NOCOLOR "\033[0m"
+
+// Overflow mode with a stalled consumer: the writer keeps adding while the
+// reader sleeps, the backlog goes to segment files, and the reader then
+// has to get everything back in order.
+//
+//	queue-spill [items] [dir]
+
+static long items = 5000000;
+
+void *reader(void *arg) {
+	queue_t *q = (queue_t *)arg;
+	int expected = 0;
+
+	printf("reader [%d %d %d]: stalled\n", getpid(), getppid(), gettid());
+	sleep(1);
+	printf("reader: draining\n");
+
+	for (long i = 0; i < items; i++) {
+		int val = -1;
+
+		queue_get(q, &val);
+
+		if (expected != val)
+			printf(RED"ERROR: get value is %d but expected - %d" NOCOLOR "\n", val, expected);
+
+		expected = val + 1;
+	}
+
+	return NULL;
+}
+
+int main(int argc, char **argv) {
+	const char *dir = argc > 2 ? argv[2] : "/tmp";
+	struct rusage ru;
+	pthread_t tid;
+	queue_t *q;
+	int err;
+
+	if (argc > 1)
+		items = atol(argv[1]);
+
+	printf("main [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	q = queue_init(1000);
+
+	// small segments, so a few million items cycle through several files
+	err = queue_set_spill(q, dir, 1 << 16);
+	if (err) {
+		printf("main: queue_set_spill(%s) failed: %s\n", dir, strerror(err));
+		return -1;
+	}
+
+	err = pthread_create(&tid, NULL, reader, q);
+	if (err) {
+		printf("main: pthread_create() failed: %s\n", strerror(err));
+		return -1;
+	}
+
+	for (long i = 0; i < items; i++)
+		queue_add(q, i);
+
+	printf("writer: done\n");
+	queue_print_stats(q);
+
+	pthread_join(tid, NULL);
+	queue_print_stats(q);
+
+	getrusage(RUSAGE_SELF, &ru);
+	printf("max rss %ld kB\n", ru.ru_maxrss);
+
+	queue_destroy(q);
+
+	return 0;
+}
@@ -0,0 +1,243 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdint.h>
+
+#include "queue.h"
+
+#define LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define STORE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELAXED)
+
+queue_t* queue_init(int max_count) {
+    return queue_init_lanes(max_count, QUEUE_LANES);
+}
+
+queue_t* queue_init_lanes(int max_count, int nlanes) {
+    int err;
+    queue_t *q;
+
+    if (nlanes < 1)
+        nlanes = 1;
+
+    err = posix_memalign((void **)&q, CACHE_LINE_SIZE, sizeof(queue_t));
+    if (err) {
+        printf("Cannot allocate memory for a queue\n");
+        abort();
+    }
+
+    err = posix_memalign((void **)&q->lanes, CACHE_LINE_SIZE, nlanes * sizeof(qlane_t));
+    if (err) {
+        printf("Cannot allocate memory for queue lanes\n");
+        free(q);
+        abort();
+    }
+
+    q->max_count = max_count;
+    q->nlanes = nlanes;
+    q->drain = QUEUE_DRAIN_RR;
+    q->next_lane = 0;
+
+    for (int i = 0; i < nlanes; i++) {
+        qlane_t *lane = &q->lanes[i];
+
+        lane->first = lane->last = NULL;
+        lane->count = 0;
+        lane->add_count = lane->get_count = 0;
+
+        err = pthread_mutex_init(&lane->lock, NULL);
+        if (err) {
+            printf("queue_init: pthread_mutex_init (lane %d) failed: %s\n", i, strerror(err));
+            abort();
+        }
+    }
+
+    err = sem_init(&q->empty, 0, max_count);
+    if (err) {
+        printf("queue_init: sem_init (empty) failed\n");
+        abort();
+    }
+
+    err = sem_init(&q->full, 0, 0);
+    if (err) {
+        printf("queue_init: sem_init (full) failed\n");
+        abort();
+    }
+
+    err = pthread_key_create(&q->lane_key, NULL);
+    if (err) {
+        printf("queue_init: pthread_key_create (lane) failed: %s\n", strerror(err));
+        abort();
+    }
+
+    err = pthread_key_create(&q->cursor_key, NULL);
+    if (err) {
+        printf("queue_init: pthread_key_create (cursor) failed: %s\n", strerror(err));
+        abort();
+    }
+
+    return q;
+}
+
+void queue_destroy(queue_t *q) {
+    if (q == NULL) return;
+
+    pthread_key_delete(q->lane_key);
+    pthread_key_delete(q->cursor_key);
+
+    sem_destroy(&q->empty);
+    sem_destroy(&q->full);
+
+    for (int i = 0; i < q->nlanes; i++) {
+        qlane_t *lane = &q->lanes[i];
+        qnode_t *current = lane->first;
+
+        while (current != NULL) {
+            qnode_t *temp = current;
+            current = current->next;
+            free(temp);
+        }
+
+        pthread_mutex_destroy(&lane->lock);
+    }
+
+    free(q->lanes);
+    free(q);
+}
+
+void queue_bind_lane(queue_t *q, int lane) {
+    if (lane < 0 || lane >= q->nlanes) {
+        printf("queue_bind_lane: lane %d out of range 0..%d\n", lane, q->nlanes - 1);
+        abort();
+    }
+
+    // stored as lane + 1: 0 is what pthread_getspecific returns when unbound
+    pthread_setspecific(q->lane_key, (void *)(intptr_t)(lane + 1));
+}
+
+void queue_set_drain(queue_t *q, int drain) {
+    STORE(&q->drain, drain);
+}
+
+static qlane_t *queue_producer_lane(queue_t *q) {
+    intptr_t lane = (intptr_t)pthread_getspecific(q->lane_key);
+
+    if (!lane) {
+        lane = __atomic_fetch_add(&q->next_lane, 1, __ATOMIC_RELAXED) % q->nlanes + 1;
+        pthread_setspecific(q->lane_key, (void *)lane);
+    }
+
+    return &q->lanes[lane - 1];
+}
+
+// Lane a reader should try next. The counts are read without the lane
+// locks, so the answer may be stale; queue_get rechecks under the lock.
+static int queue_pick_lane(queue_t *q, int start) {
+    int best = start, best_count = 0;
+
+    for (int i = 0; i < q->nlanes; i++) {
+        int n = (start + i) % q->nlanes;
+        int count = LOAD(&q->lanes[n].count);
+
+        if (count > best_count) {
+            best = n;
+            best_count = count;
+
+            if (LOAD(&q->drain) == QUEUE_DRAIN_RR)
+                break;
+        }
+    }
+
+    return best;
+}
+
+int queue_add(queue_t *q, int val) {
+    qlane_t *lane = queue_producer_lane(q);
+    qnode_t *new = malloc(sizeof(qnode_t));
+    if (!new) {
+        printf("Cannot allocate memory for new node\n");
+        abort();
+    }
+
+    new->val = val;
+    new->next = NULL;
+
+    sem_wait(&q->empty);
+
+    pthread_mutex_lock(&lane->lock);
+
+    if (!lane->first)
+        lane->first = lane->last = new;
+    else {
+        lane->last->next = new;
+        lane->last = new;
+    }
+
+    STORE(&lane->count, lane->count + 1);
+    lane->add_count++;
+
+    pthread_mutex_unlock(&lane->lock);
+    sem_post(&q->full);
+    return 1;
+}
+
+// A successful sem_wait on full reserves one item in some lane: every
+// item is linked into its lane before its post, and each reader takes
+// exactly one item per token. So the scan below always ends, even if
+// other readers empty the lane it looked at first.
+int queue_get(queue_t *q, int *val) {
+    intptr_t cursor = (intptr_t)pthread_getspecific(q->cursor_key);
+    int n = cursor ? cursor - 1 : 0;
+    qnode_t *tmp = NULL;
+
+    sem_wait(&q->full);
+
+    while (!tmp) {
+        qlane_t *lane;
+
+        n = queue_pick_lane(q, n);
+        lane = &q->lanes[n];
+
+        pthread_mutex_lock(&lane->lock);
+
+        tmp = lane->first;
+        if (tmp) {
+            lane->first = tmp->next;
+            if (!lane->first)
+                lane->last = NULL;
+
+            STORE(&lane->count, lane->count - 1);
+            lane->get_count++;
+        }
+
+        pthread_mutex_unlock(&lane->lock);
+
+        n = (n + 1) % q->nlanes;
+    }
+
+    pthread_setspecific(q->cursor_key, (void *)(intptr_t)(n + 1));
+
+    sem_post(&q->empty);
+
+    *val = tmp->val;
+    free(tmp);
+    return 1;
+}
+
+void queue_print_stats(queue_t *q) {
+	long add_count = 0, get_count = 0;
+	int count = 0;
+
+	for (int i = 0; i < q->nlanes; i++) {
+		qlane_t *lane = &q->lanes[i];
+
+		pthread_mutex_lock(&lane->lock);
+		count += lane->count;
+		add_count += lane->add_count;
+		get_count += lane->get_count;
+		printf("lane %d: size %d; counts (%ld %ld)\n",
+			i, lane->count, lane->add_count, lane->get_count);
+		pthread_mutex_unlock(&lane->lock);
+	}
+
+	printf("queue stats: current size %d; counts (%ld %ld %ld)\n",
+		count, add_count, get_count, add_count - get_count);
+}
@@ -0,0 +1,75 @@
+#ifndef __FITOS_QUEUE_H__
+#define __FITOS_QUEUE_H__
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#define CACHE_LINE_SIZE 64
+
+// Lanes used by queue_init
+#define QUEUE_LANES 8
+
+// How queue_get picks the lane to take from
+#define QUEUE_DRAIN_RR 0		// next non-empty lane after the last one used
+#define QUEUE_DRAIN_DEEPEST 1		// lane with the most items
+
+typedef struct _QueueNode {
+	int val;
+	struct _QueueNode *next;
+} qnode_t;
+
+// One independent FIFO with its own lock. A producer always adds to the
+// same lane, which is what keeps its items in order.
+typedef struct _QueueLane {
+	pthread_mutex_t lock;
+	qnode_t *first;
+	qnode_t *last;
+
+	// written under lock, read without it to skip empty lanes
+	int count;
+
+	long add_count;
+	long get_count;
+} __attribute__((aligned(CACHE_LINE_SIZE))) qlane_t;
+
+// Sharded queue: producers are spread over lanes so they do not all
+// contend on one lock and one tail. The semaphores keep the total of all
+// lanes within max_count and let readers sleep until some lane has data.
+typedef struct _Queue {
+	sem_t empty __attribute__((aligned(CACHE_LINE_SIZE)));
+	sem_t full __attribute__((aligned(CACHE_LINE_SIZE)));
+
+	int max_count __attribute__((aligned(CACHE_LINE_SIZE)));
+	int nlanes;
+	int drain;
+	qlane_t *lanes;
+
+	// lane of each producer and drain position of each consumer, stored
+	// as index + 1 so that 0 means "not assigned yet"
+	pthread_key_t lane_key;
+	pthread_key_t cursor_key;
+	int next_lane;
+} queue_t;
+
+queue_t* queue_init(int max_count);
+queue_t* queue_init_lanes(int max_count, int nlanes);
+void queue_destroy(queue_t *q);
+
+// Binds the calling thread's queue_add to a lane, 0 to nlanes - 1; other
+// values abort. Threads that never call it get lanes round-robin on their
+// first add.
+void queue_bind_lane(queue_t *q, int lane);
+void queue_set_drain(queue_t *q, int drain);
+
+int queue_add(queue_t *q, int val);
+int queue_get(queue_t *q, int *val);
+void queue_print_stats(queue_t *q);
+
+#endif		// __FITOS_QUEUE_H__
@@ -0,0 +1,47 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "queue.h"
+
+#define RED "\033[41m"
+#define NOCOLOR "\033[0m"
+
+//	queue-consumer [name]
+
+int main(int argc, char **argv) {
+	const char *name = argc > 1 ? argv[1] : "/fitos-queue";
+	int expected = 0;
+	queue_t *q;
+
+	printf("consumer: [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	while (!(q = queue_attach(name)))
+		usleep(10000);
+
+	printf("consumer: attached to %s\n", name);
+
+	while (1) {
+		int val = -1;
+
+		queue_get(q, &val);
+		if (val == -1)
+			break;
+
+		if (expected != val)
+			printf(RED"ERROR: get value is %d but expected - %d" NOCOLOR "\n", val, expected);
+
+		expected = val + 1;
+	}
+
+	printf("consumer: got %d values\n", expected);
+	queue_print_stats(q);
+	queue_destroy(q);
+
+	return 0;
+}
@@ -0,0 +1,38 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "queue.h"
+
+// Creates a named queue and fills it with 0 .. items-1 and -1 at the end.
+// Run queue-consumer with the same name in another shell.
+//
+//	queue-producer [name] [items]
+
+int main(int argc, char **argv) {
+	const char *name = argc > 1 ? argv[1] : "/fitos-queue";
+	long items = argc > 2 ? atol(argv[2]) : 10000000;
+	queue_t *q;
+
+	printf("producer: [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	q = queue_init_shm(name, 1000);
+
+	for (long i = 0; i < items; i++)
+		queue_add(q, i);
+	queue_add(q, -1);
+
+	// the consumer still uses the semaphores until it has taken everything
+	while (__atomic_load_n(&q->shm->get_count, __ATOMIC_RELAXED) < items + 1)
+		usleep(1000);
+
+	queue_print_stats(q);
+	queue_destroy(q);
+
+	return 0;
+}
@@ -0,0 +1,251 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <limits.h>
+
+#include "queue.h"
+#include "futex.h"
+
+#define LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_SEQ_CST)
+#define STORE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_SEQ_CST)
+#define XCHG(ptr, val) __atomic_exchange_n(ptr, val, __ATOMIC_SEQ_CST)
+
+static uint32_t ring_size(int max_count) {
+    uint32_t n = 1;
+
+    while (n < (uint32_t)max_count)
+        n <<= 1;
+
+    return n;
+}
+
+static size_t qshm_size(int max_count) {
+    return sizeof(qshm_t) + ring_size(max_count) * sizeof(int);
+}
+
+static void qshm_init(qshm_t *shm, int max_count) {
+    pthread_mutexattr_t attr;
+    int err;
+
+    shm->max_count = max_count;
+    shm->mask = ring_size(max_count) - 1;
+    shm->head = shm->tail = 0;
+    shm->add_waiting = shm->get_waiting = 0;
+    shm->add_count = shm->get_count = 0;
+
+    // robust: a process that dies holding a lock must not hang the others
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+
+    err = pthread_mutex_init(&shm->add_lock, &attr);
+    if (err) {
+        printf("queue_init: pthread_mutex_init (add) failed: %s\n", strerror(err));
+        abort();
+    }
+
+    err = pthread_mutex_init(&shm->get_lock, &attr);
+    if (err) {
+        printf("queue_init: pthread_mutex_init (get) failed: %s\n", strerror(err));
+        abort();
+    }
+
+    pthread_mutexattr_destroy(&attr);
+
+    // attaching processes wait for the magic, so it goes last
+    __atomic_store_n(&shm->magic, QSHM_MAGIC, __ATOMIC_RELEASE);
+}
+
+static queue_t *queue_new(void) {
+    queue_t *q = malloc(sizeof(queue_t));
+    if (!q) {
+        printf("Cannot allocate memory for a queue\n");
+        abort();
+    }
+
+    q->name[0] = '\0';
+    q->owner = 1;
+
+    return q;
+}
+
+queue_t* queue_init(int max_count) {
+    queue_t *q = queue_new();
+
+    q->size = qshm_size(max_count);
+    q->shm = mmap(NULL, q->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (q->shm == MAP_FAILED) {
+        printf("queue_init: mmap failed: %s\n", strerror(errno));
+        abort();
+    }
+
+    qshm_init(q->shm, max_count);
+
+    return q;
+}
+
+queue_t* queue_init_shm(const char *name, int max_count) {
+    queue_t *q = queue_new();
+    int fd;
+
+    snprintf(q->name, sizeof(q->name), "%s", name);
+    q->size = qshm_size(max_count);
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        printf("queue_init_shm: shm_open(%s) failed: %s\n", name, strerror(errno));
+        abort();
+    }
+
+    if (ftruncate(fd, q->size)) {
+        printf("queue_init_shm: ftruncate failed: %s\n", strerror(errno));
+        shm_unlink(name);
+        abort();
+    }
+
+    q->shm = mmap(NULL, q->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (q->shm == MAP_FAILED) {
+        printf("queue_init_shm: mmap failed: %s\n", strerror(errno));
+        shm_unlink(name);
+        abort();
+    }
+
+    qshm_init(q->shm, max_count);
+
+    return q;
+}
+
+// Returns NULL if there is no such queue (yet), so a consumer can be
+// started before its producer and retry.
+queue_t* queue_attach(const char *name) {
+    struct stat st;
+    queue_t *q;
+    int fd;
+
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return NULL;
+
+    // the creator may not have sized and filled the segment yet
+    if (fstat(fd, &st) || st.st_size < (off_t)sizeof(qshm_t)) {
+        close(fd);
+        return NULL;
+    }
+
+    q = queue_new();
+    snprintf(q->name, sizeof(q->name), "%s", name);
+    q->owner = 0;
+    q->size = st.st_size;
+
+    q->shm = mmap(NULL, q->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (q->shm == MAP_FAILED) {
+        printf("queue_attach: mmap failed: %s\n", strerror(errno));
+        abort();
+    }
+
+    if (__atomic_load_n(&q->shm->magic, __ATOMIC_ACQUIRE) != QSHM_MAGIC) {
+        munmap(q->shm, q->size);
+        free(q);
+        return NULL;
+    }
+
+    return q;
+}
+
+void queue_destroy(queue_t *q) {
+    if (q == NULL) return;
+
+    if (q->owner) {
+        pthread_mutex_destroy(&q->shm->add_lock);
+        pthread_mutex_destroy(&q->shm->get_lock);
+
+        if (q->name[0])
+            shm_unlink(q->name);
+    }
+
+    munmap(q->shm, q->size);
+    free(q);
+}
+
+// Takes a side lock. If its owner died, the lock is handed over with
+// EOWNERDEAD. head and tail are stored last, after the slot, so the ring
+// is whole whatever point the owner died at (its item or one count may be
+// lost): marking the lock consistent is enough.
+static void qshm_lock(pthread_mutex_t *lock) {
+    int err = pthread_mutex_lock(lock);
+
+    if (err == EOWNERDEAD)
+        err = pthread_mutex_consistent(lock);
+
+    if (err) {
+        printf("queue: pthread_mutex_lock failed: %s\n", strerror(err));
+        abort();
+    }
+}
+
+// The flag store and the counter load on one side, and the counter store
+// and flag load on the other, are all seq_cst: either the sleeper sees the
+// new counter and does not sleep, or the other side sees the flag.
+int queue_add(queue_t *q, int val) {
+    qshm_t *shm = q->shm;
+    uint32_t tail, head;
+
+    qshm_lock(&shm->add_lock);
+
+    tail = shm->tail;
+    while (tail - (head = LOAD(&shm->head)) == (uint32_t)shm->max_count) {
+        STORE(&shm->add_waiting, 1);
+        if (tail - LOAD(&shm->head) != (uint32_t)shm->max_count)
+            break;
+        futex_wait(&shm->head, head);
+    }
+
+    shm->buf[tail & shm->mask] = val;
+    STORE(&shm->tail, tail + 1);
+    shm->add_count++;
+
+    pthread_mutex_unlock(&shm->add_lock);
+
+    if (LOAD(&shm->get_waiting) && XCHG(&shm->get_waiting, 0))
+        futex_wake(&shm->tail, INT_MAX);
+    return 1;
+}
+
+int queue_get(queue_t *q, int *val) {
+    qshm_t *shm = q->shm;
+    uint32_t head, tail;
+
+    qshm_lock(&shm->get_lock);
+
+    head = shm->head;
+    while ((tail = LOAD(&shm->tail)) == head) {
+        STORE(&shm->get_waiting, 1);
+        if (LOAD(&shm->tail) != head)
+            break;
+        futex_wait(&shm->tail, tail);
+    }
+
+    *val = shm->buf[head & shm->mask];
+    STORE(&shm->head, head + 1);
+    shm->get_count++;
+
+    pthread_mutex_unlock(&shm->get_lock);
+
+    if (LOAD(&shm->add_waiting) && XCHG(&shm->add_waiting, 0))
+        futex_wake(&shm->head, INT_MAX);
+    return 1;
+}
+
+void queue_print_stats(queue_t *q) {
+	qshm_t *shm = q->shm;
+	long add_count = __atomic_load_n(&shm->add_count, __ATOMIC_RELAXED);
+	long get_count = __atomic_load_n(&shm->get_count, __ATOMIC_RELAXED);
+
+	printf("queue stats: %s; counts (%ld %ld %ld)\n",
+		q->name[0] ? q->name : "anonymous",
+		add_count, get_count, add_count - get_count);
+}
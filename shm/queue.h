@@ -0,0 +1,73 @@
+#ifndef __FITOS_QUEUE_H__
+#define __FITOS_QUEUE_H__
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define CACHE_LINE_SIZE 64
+
+#define QSHM_MAGIC 0x314d4853	// "SHM1"
+
+// Everything that lives in the shared segment. Only counters and
+// process-shared primitives in here: the segment is mapped at a different
+// address in every process.
+//
+// head and tail are free-running and double as futex words: a consumer
+// finding the ring empty sleeps on tail, a producer finding it full on
+// head. The *_waiting flags tell the other side that somebody may sleep;
+// the first waker clears the flag, so a burst of adds makes one
+// FUTEX_WAKE call instead of one per item.
+typedef struct _QueueShm {
+	uint32_t magic;
+	int max_count;
+	uint32_t mask;		// ring size - 1, ring size is a power of 2
+
+	// consumer side
+	uint32_t head __attribute__((aligned(CACHE_LINE_SIZE)));
+	uint32_t add_waiting;
+	pthread_mutex_t get_lock;
+	long get_count;
+
+	// producer side
+	uint32_t tail __attribute__((aligned(CACHE_LINE_SIZE)));
+	uint32_t get_waiting;
+	pthread_mutex_t add_lock;
+	long add_count;
+
+	int buf[] __attribute__((aligned(CACHE_LINE_SIZE)));
+} qshm_t;
+
+// Process local handle of a queue in shared memory.
+typedef struct _Queue {
+	qshm_t *shm;
+	size_t size;
+
+	// shm_open name, empty for an anonymous queue
+	char name[64];
+	int owner;
+} queue_t;
+
+// Anonymous shared mapping: shared with children forked after the call.
+queue_t* queue_init(int max_count);
+
+// Named segment (see shm_open(3), e.g. "/fitos-queue") that other processes
+// can queue_attach to. The creator's queue_destroy unlinks it.
+queue_t* queue_init_shm(const char *name, int max_count);
+queue_t* queue_attach(const char *name);
+
+// Unmaps the queue. Only the creator tears down the locks and removes
+// the name; attached processes must be done with it by then.
+void queue_destroy(queue_t *q);
+
+int queue_add(queue_t *q, int val);
+int queue_get(queue_t *q, int *val);
+void queue_print_stats(queue_t *q);
+
+#endif		// __FITOS_QUEUE_H__
@@ -0,0 +1,131 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <assert.h>
+
+#include "queue.h"
+
+#define LOAD_RELAXED(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define LOAD_ACQUIRE(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+
+void *qmonitor(void *arg) {
+	queue_t *q = (queue_t *)arg;
+
+	printf("qmonitor: [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	while (1) {
+		queue_print_stats(q);
+		sleep(1);
+	}
+
+	return NULL;
+}
+
+static unsigned long ring_size(int max_count) {
+    unsigned long size = 1;
+
+    while (size < (unsigned long)max_count)
+        size <<= 1;
+
+    return size;
+}
+
+queue_t* queue_init(int max_count) {
+    int err;
+    queue_t *q;
+
+    assert(max_count > 0);
+
+    err = posix_memalign((void **)&q, CACHE_LINE_SIZE, sizeof(queue_t));
+    if (err) {
+        printf("Cannot allocate memory for a queue\n");
+        abort();
+    }
+
+    q->mask = ring_size(max_count) - 1;
+    q->max_count = max_count;
+
+    q->buf = malloc((q->mask + 1) * sizeof(int));
+    if (!q->buf) {
+        printf("Cannot allocate memory for a queue ring\n");
+        free(q);
+        abort();
+    }
+
+    q->head = q->tail = 0;
+    q->head_cache = q->tail_cache = 0;
+
+    q->add_attempts = q->get_attempts = 0;
+    q->add_count = q->get_count = 0;
+
+    q->monitor = getenv(QMONITOR_ENV) != NULL;
+    err = q->monitor ? pthread_create(&q->qmonitor_tid, NULL, qmonitor, q) : 0;
+    if (err) {
+        printf("queue_init: pthread_create() failed: %s\n", strerror(err));
+        free(q->buf);
+        free(q);
+        abort();
+    }
+
+    return q;
+}
+
+void queue_destroy(queue_t *q) {
+    if (q == NULL) return;
+
+    if (q->monitor) {
+        pthread_cancel(q->qmonitor_tid);
+        pthread_join(q->qmonitor_tid, NULL);
+    }
+
+    free(q->buf);
+    free(q);
+}
+
+int queue_add(queue_t *q, int val) {
+    unsigned long tail = LOAD_RELAXED(&q->tail);
+
+    q->add_attempts++;
+
+    // Look at the reader's index only when the cached copy says we are full.
+    if (tail - q->head_cache == q->max_count) {
+        q->head_cache = LOAD_ACQUIRE(&q->head);
+        if (tail - q->head_cache == q->max_count)
+            return 0;
+    }
+
+    q->buf[tail & q->mask] = val;
+    STORE_RELEASE(&q->tail, tail + 1);
+
+    q->add_count++;
+    return 1;
+}
+
+int queue_get(queue_t *q, int *val) {
+    unsigned long head = LOAD_RELAXED(&q->head);
+
+    q->get_attempts++;
+
+    // Look at the writer's index only when the cached copy says we are empty.
+    if (head == q->tail_cache) {
+        q->tail_cache = LOAD_ACQUIRE(&q->tail);
+        if (head == q->tail_cache)
+            return 0;
+    }
+
+    *val = q->buf[head & q->mask];
+    STORE_RELEASE(&q->head, head + 1);
+
+    q->get_count++;
+    return 1;
+}
+
+void queue_print_stats(queue_t *q) {
+	unsigned long head = LOAD_ACQUIRE(&q->head);
+	unsigned long tail = LOAD_ACQUIRE(&q->tail);
+
+	printf("queue stats: current size %ld; attempts: (%ld %ld %ld); counts (%ld %ld %ld)\n",
+		(long)(tail - head),
+		q->add_attempts, q->get_attempts, q->add_attempts - q->get_attempts,
+		q->add_count, q->get_count, q->add_count -q->get_count);
+}
@@ -0,0 +1,47 @@
+#ifndef __FITOS_QUEUE_H__
+#define __FITOS_QUEUE_H__
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "qmonitor.h"
+
+#define CACHE_LINE_SIZE 64
+
+// Single-producer single-consumer queue on a preallocated ring.
+// Only one thread may call queue_add and only one thread may call queue_get.
+typedef struct _Queue {
+	// producer side: written by the writer only
+	unsigned long tail __attribute__((aligned(CACHE_LINE_SIZE)));
+	unsigned long head_cache;
+	long add_attempts;
+	long add_count;
+
+	// consumer side: written by the reader only
+	unsigned long head __attribute__((aligned(CACHE_LINE_SIZE)));
+	unsigned long tail_cache;
+	long get_attempts;
+	long get_count;
+
+	// read-only after queue_init
+	int *buf __attribute__((aligned(CACHE_LINE_SIZE)));
+	unsigned long mask;
+	int max_count;
+
+	pthread_t qmonitor_tid;
+	int monitor;
+} queue_t;
+
+queue_t* queue_init(int max_count);
+void queue_destroy(queue_t *q);
+int queue_add(queue_t *q, int val);
+int queue_get(queue_t *q, int *val);
+void queue_print_stats(queue_t *q);
+
+#endif		// __FITOS_QUEUE_H__
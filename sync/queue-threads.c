@@ -11,33 +11,17 @@
 #include <sched.h>
 
 #include "queue.h"
+#include "topo.h"
 
 #define RED "\033[41m"
 #define NOCOLOR "\033[0m"
 
-void set_cpu(int n) {
-	int err;
-	cpu_set_t cpuset;
-	pthread_t tid = pthread_self();
-
-	CPU_ZERO(&cpuset);
-	CPU_SET(n, &cpuset);
-
-	err = pthread_setaffinity_np(tid, sizeof(cpu_set_t), &cpuset);
-	if (err) {
-		printf("set_cpu: pthread_setaffinity failed for cpu %d\n", n);
-		return;
-	}
-
-	printf("set_cpu: set cpu %d\n", n);
-}
-
 void *reader(void *arg) {
 	int expected = 0;
 	queue_t *q = (queue_t *)arg;
 	printf("reader [%d %d %d]\n", getpid(), getppid(), gettid());
 
-	set_cpu(1);
+	place_self(0);
 
 	while (1) {
 		int val = -1;
@@ -59,7 +43,7 @@ void *writer(void *arg) {
 	queue_t *q = (queue_t *)arg;
 	printf("writer [%d %d %d]\n", getpid(), getppid(), gettid());
 
-	set_cpu(1);
+	place_self(1);
 
 	while (1) {
 		int ok = queue_add(q, i);
@@ -9,6 +9,8 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "qmonitor.h"
+
 typedef struct _QueueNode {
 	int val;
 	struct _QueueNode *next;
@@ -19,6 +21,7 @@ typedef struct _Queue {
 	qnode_t *last;
 
 	pthread_t qmonitor_tid;
+	int monitor;
 
 	int count;
 	int max_count;
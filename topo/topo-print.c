@@ -0,0 +1,50 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "topo.h"
+
+// Prints the CPUs this process may use and the slot order of every
+// placement policy, or of the one given as argument (a policy name or a
+// CPU list).
+//
+//	topo-print [policy]
+
+int main(int argc, char **argv) {
+	static topo_t topo;
+	static place_t place;
+	place_policy_t policy;
+	int err;
+
+	err = topo_load(&topo);
+	if (err) {
+		printf("topo_load failed: %s\n", strerror(err));
+		return 1;
+	}
+
+	printf("cpu package core llc node smt core_rank\n");
+	for (int i = 0; i < topo.ncpus; i++) {
+		tcpu_t *c = &topo.cpus[i];
+
+		printf("%3d %7d %4d %3d %4d %3d %9d\n", c->cpu, c->package, c->core,
+			c->llc, c->node, c->smt, c->core_rank);
+	}
+
+	if (argc > 1) {
+		if (place_parse(&place, &topo, argv[1])) {
+			printf("bad placement %s\n", argv[1]);
+			return 1;
+		}
+
+		place_print(&place);
+		return 0;
+	}
+
+	for (policy = PLACE_NONE; policy <= PLACE_NUMA; policy++) {
+		place_init(&place, &topo, policy);
+		place_print(&place);
+	}
+
+	return 0;
+}
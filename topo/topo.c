@@ -0,0 +1,362 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include "topo.h"
+
+#define SYSFS_CPU "/sys/devices/system/cpu"
+
+static const char *policy_names[] = {
+	[PLACE_NONE] = "none",
+	[PLACE_SAME] = "same",
+	[PLACE_SMT] = "smt",
+	[PLACE_LLC] = "llc",
+	[PLACE_SPREAD] = "spread",
+	[PLACE_NUMA] = "numa",
+	[PLACE_LIST] = "list",
+};
+
+static int read_int(const char *path, int def) {
+	FILE *f = fopen(path, "r");
+	int val;
+
+	if (!f)
+		return def;
+
+	if (fscanf(f, "%d", &val) != 1)
+		val = def;
+
+	fclose(f);
+	return val;
+}
+
+// The cache index with the highest level is the LLC; CPUs sharing it are
+// named by the lowest of them.
+static int cpu_llc(int cpu, int def) {
+	char path[256];
+	int best = -1, llc = def;
+
+	for (int i = 0; ; i++) {
+		int level;
+
+		snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cache/index%d/level", cpu, i);
+		level = read_int(path, -1);
+		if (level < 0)
+			break;
+
+		if (level > best) {
+			best = level;
+			snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cache/index%d/shared_cpu_list", cpu, i);
+			// "0-3,8-11": %d stops at the first cpu
+			llc = read_int(path, def);
+		}
+	}
+
+	return llc;
+}
+
+// cpuN has a nodeM link in its directory on NUMA kernels
+static int cpu_node(int cpu) {
+	char path[256];
+	struct dirent *de;
+	int node = 0;
+	DIR *dir;
+
+	snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d", cpu);
+	dir = opendir(path);
+	if (!dir)
+		return 0;
+
+	while ((de = readdir(dir))) {
+		if (!strncmp(de->d_name, "node", 4) && de->d_name[4] >= '0' && de->d_name[4] <= '9') {
+			node = atoi(de->d_name + 4);
+			break;
+		}
+	}
+
+	closedir(dir);
+	return node;
+}
+
+int topo_load(topo_t *t) {
+	char path[256];
+	cpu_set_t allowed;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed))
+		return errno;
+
+	t->ncpus = 0;
+	for (int cpu = 0; cpu < TOPO_MAX_CPUS; cpu++) {
+		tcpu_t *c;
+
+		if (!CPU_ISSET(cpu, &allowed))
+			continue;
+
+		c = &t->cpus[t->ncpus++];
+		c->cpu = cpu;
+
+		snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/topology/physical_package_id", cpu);
+		c->package = read_int(path, 0);
+		snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/topology/core_id", cpu);
+		c->core = read_int(path, cpu);
+
+		c->llc = cpu_llc(cpu, c->package);
+		c->node = cpu_node(cpu);
+	}
+
+	// cpus are in increasing order, so the first thread of a core is the
+	// one with the lowest number
+	for (int i = 0; i < t->ncpus; i++) {
+		tcpu_t *c = &t->cpus[i];
+
+		c->smt = 0;
+		for (int j = 0; j < i; j++) {
+			if (t->cpus[j].package == c->package && t->cpus[j].core == c->core)
+				c->smt++;
+		}
+	}
+
+	// siblings take the rank of their first thread
+	for (int i = 0; i < t->ncpus; i++) {
+		tcpu_t *c = &t->cpus[i];
+
+		c->core_rank = 0;
+		for (int j = 0; j < i; j++) {
+			tcpu_t *o = &t->cpus[j];
+
+			if (o->package == c->package && o->core == c->core) {
+				c->core_rank = o->core_rank;
+				break;
+			}
+			if (o->llc == c->llc && o->smt == 0)
+				c->core_rank++;
+		}
+	}
+
+	return 0;
+}
+
+int place_policy(const char *name, place_policy_t *policy) {
+	// a list is not a name, place_parse reads it
+	for (int i = 0; i < PLACE_LIST; i++) {
+		if (!strcmp(name, policy_names[i])) {
+			*policy = i;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+const char *place_name(place_policy_t policy) {
+	return policy_names[policy];
+}
+
+typedef struct _PlaceKey {
+	int k[3];
+	int cpu;
+} pkey_t;
+
+static int cmp_key(const void *a, const void *b) {
+	const pkey_t *x = a, *y = b;
+
+	for (int i = 0; i < 3; i++) {
+		if (x->k[i] != y->k[i])
+			return x->k[i] < y->k[i] ? -1 : 1;
+	}
+
+	return x->cpu - y->cpu;
+}
+
+void place_init(place_t *p, const topo_t *t, place_policy_t policy) {
+	static pkey_t keys[TOPO_MAX_CPUS];
+	const tcpu_t *first = &t->cpus[0];
+	int n = 0;
+
+	p->policy = policy;
+	p->node = first->node;
+	p->ncpus = 0;
+
+	if (policy == PLACE_NONE || t->ncpus == 0)
+		return;
+
+	if (policy == PLACE_SAME) {
+		p->cpus[p->ncpus++] = first->cpu;
+		return;
+	}
+
+	for (int i = 0; i < t->ncpus; i++) {
+		const tcpu_t *c = &t->cpus[i];
+		pkey_t *key = &keys[n];
+
+		if (policy == PLACE_LLC && c->llc != first->llc)
+			continue;
+		if (policy == PLACE_NUMA && c->node != first->node)
+			continue;
+
+		key->cpu = c->cpu;
+
+		switch (policy) {
+		case PLACE_SMT:
+			key->k[0] = c->package;
+			key->k[1] = c->core;
+			key->k[2] = c->smt;
+			break;
+		case PLACE_LLC:
+		case PLACE_NUMA:
+		case PLACE_SPREAD:
+		default:
+			// one thread per core before any sibling; spread also goes
+			// round the LLCs before a second core of the same one
+			key->k[0] = c->smt;
+			key->k[1] = c->core_rank;
+			key->k[2] = c->llc;
+			break;
+		}
+
+		n++;
+	}
+
+	qsort(keys, n, sizeof(pkey_t), cmp_key);
+
+	for (int i = 0; i < n; i++)
+		p->cpus[p->ncpus++] = keys[i].cpu;
+}
+
+int place_parse(place_t *p, const topo_t *t, const char *arg) {
+	place_policy_t policy;
+	const char *s = arg;
+
+	if (!place_policy(arg, &policy)) {
+		place_init(p, t, policy);
+		return 0;
+	}
+
+	p->policy = PLACE_LIST;
+	p->node = 0;
+	p->ncpus = 0;
+
+	while (*s) {
+		char *end;
+		long cpu = strtol(s, &end, 10);
+
+		if (end == s || cpu < 0 || cpu >= TOPO_MAX_CPUS || p->ncpus == TOPO_MAX_CPUS)
+			return -1;
+		p->cpus[p->ncpus++] = cpu;
+
+		s = end;
+		if (*s == ',')
+			s++;
+		else if (*s)
+			return -1;
+	}
+
+	return p->ncpus ? 0 : -1;
+}
+
+int place_cpu(const place_t *p, int slot) {
+	if (p->ncpus == 0)
+		return -1;
+
+	return p->cpus[slot % p->ncpus];
+}
+
+int place_thread(const place_t *p, int slot) {
+	return place_tid(p, pthread_self(), slot);
+}
+
+int place_tid(const place_t *p, pthread_t tid, int slot) {
+	int cpu = place_cpu(p, slot);
+	cpu_set_t cpuset;
+	int err;
+
+	if (cpu < 0)
+		return -1;
+
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu, &cpuset);
+
+	err = pthread_setaffinity_np(tid, sizeof(cpu_set_t), &cpuset);
+	if (err) {
+		printf("place_tid: pthread_setaffinity failed for cpu %d: %s\n", cpu, strerror(err));
+		return -1;
+	}
+
+	return cpu;
+}
+
+int place_mem(const place_t *p, void *addr, size_t len) {
+	unsigned long mask[16] = { 0 };
+	long page = sysconf(_SC_PAGESIZE);
+	unsigned long start, end;
+
+	if (p->policy != PLACE_NUMA || len == 0)
+		return 0;
+
+	if (p->node >= (int)(sizeof(mask) * 8))
+		return EINVAL;
+
+	mask[p->node / (sizeof(long) * 8)] |= 1UL << (p->node % (sizeof(long) * 8));
+
+	// mbind works on whole pages
+	start = (unsigned long)addr & ~(page - 1);
+	end = ((unsigned long)addr + len + page - 1) & ~(page - 1);
+
+	if (syscall(SYS_mbind, start, end - start, MPOL_PREFERRED, mask,
+		    sizeof(mask) * 8, MPOL_MF_MOVE))
+		return errno;
+
+	return 0;
+}
+
+void place_print(const place_t *p) {
+	printf("placement %s:", place_name(p->policy));
+
+	if (p->ncpus == 0)
+		printf(" not pinned");
+	for (int i = 0; i < p->ncpus; i++)
+		printf(" %d", p->cpus[i]);
+	if (p->policy == PLACE_NUMA)
+		printf("; memory on node %d", p->node);
+
+	printf("\n");
+}
+
+static place_t self_place;
+static pthread_once_t self_once = PTHREAD_ONCE_INIT;
+
+static void place_self_init(void) {
+	const char *env = getenv(TOPO_ENV);
+	static topo_t topo;
+	int err;
+
+	err = topo_load(&topo);
+	if (err) {
+		printf("place_self: topo_load failed: %s\n", strerror(err));
+		topo.ncpus = 0;
+	}
+
+	if (!env || place_parse(&self_place, &topo, env)) {
+		if (env)
+			printf("place_self: bad %s=%s, using %s\n", TOPO_ENV, env, place_name(TOPO_DEFAULT_POLICY));
+		place_init(&self_place, &topo, TOPO_DEFAULT_POLICY);
+	}
+
+	place_print(&self_place);
+}
+
+int place_self(int slot) {
+	int cpu;
+
+	pthread_once(&self_once, place_self_init);
+
+	cpu = place_thread(&self_place, slot);
+	if (cpu >= 0)
+		printf("place_self: slot %d on cpu %d\n", slot, cpu);
+
+	return cpu;
+}
@@ -0,0 +1,93 @@
+#ifndef __FITOS_TOPO_H__
+#define __FITOS_TOPO_H__
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define TOPO_MAX_CPUS CPU_SETSIZE
+
+// Placement for place_self, e.g. CPU_PLACE=llc ./queue-threads
+#define TOPO_ENV "CPU_PLACE"
+#define TOPO_DEFAULT_POLICY PLACE_SPREAD
+
+// One CPU as /sys/devices/system/cpu describes it.
+typedef struct _TopoCpu {
+	int cpu;
+	int package;
+	int core;		// core_id, unique within a package only
+	int llc;		// lowest cpu sharing the last level cache
+	int node;		// NUMA node, 0 without NUMA
+	int smt;		// rank among the hardware threads of its core
+	int core_rank;		// rank of its core within its LLC
+} tcpu_t;
+
+// The CPUs this process may run on, in cpu order.
+typedef struct _Topo {
+	int ncpus;
+	tcpu_t cpus[TOPO_MAX_CPUS];
+} topo_t;
+
+// How thread slots 0, 1, 2, ... are mapped to CPUs. Every policy starts
+// from the first CPU the process may use.
+typedef enum _PlacePolicy {
+	PLACE_NONE,		// no pinning, the scheduler decides
+	PLACE_SAME,		// all slots on one CPU
+	PLACE_SMT,		// hardware threads of one core, then the next core
+	PLACE_LLC,		// distinct cores sharing one last level cache
+	PLACE_SPREAD,		// distinct cores, alternating between LLCs
+	PLACE_NUMA,		// cores of one node; place_mem prefers memory there
+	PLACE_LIST,		// CPUs given one by one, "1,3,5"
+} place_policy_t;
+
+typedef struct _Place {
+	place_policy_t policy;
+	int node;		// PLACE_NUMA only
+	int ncpus;
+	int cpus[TOPO_MAX_CPUS];	// slot i runs on cpus[i % ncpus]
+} place_t;
+
+// Returns 0 or an errno value. Missing sysfs files are not an error: the
+// CPU then counts as a core of its own in package and node 0.
+int topo_load(topo_t *t);
+
+// "none", "same", "smt", "llc", "spread" or "numa"; -1 if unknown
+int place_policy(const char *name, place_policy_t *policy);
+const char *place_name(place_policy_t policy);
+
+void place_init(place_t *p, const topo_t *t, place_policy_t policy);
+
+// A policy name or a comma separated CPU list. Returns 0, or -1 if arg
+// is neither.
+int place_parse(place_t *p, const topo_t *t, const char *arg);
+
+// CPU of a slot, -1 for PLACE_NONE
+int place_cpu(const place_t *p, int slot);
+
+// Pins the calling thread to the CPU of slot. Returns the CPU, or -1 if
+// the thread was left alone.
+int place_thread(const place_t *p, int slot);
+
+// The same for another thread, e.g. a worker that library code created.
+int place_tid(const place_t *p, pthread_t tid, int slot);
+
+// Sets MPOL_PREFERRED for [addr, addr + len) with mbind(2) and moves its
+// pages to the node of a PLACE_NUMA placement. Only a preference: when the
+// node is out of memory, new pages come from others instead of failing.
+// A no-op for the other policies. Returns 0 or an errno value.
+int place_mem(const place_t *p, void *addr, size_t len);
+
+void place_print(const place_t *p);
+
+// place_thread on a process wide placement, set up on first use from
+// $CPU_PLACE (TOPO_DEFAULT_POLICY if unset). For example programs that
+// have no command line to take a policy from.
+int place_self(int slot);
+
+#endif		// __FITOS_TOPO_H__
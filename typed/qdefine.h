@@ -0,0 +1,261 @@
+#ifndef __FITOS_QDEFINE_H__
+#define __FITOS_QDEFINE_H__
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// QUEUE_DEFINE(name, type, capacity, policy) emits a bounded FIFO of
+// type items, specialized at compile time:
+//
+//	typedef struct { ... } name_t;
+//	void name_init(name_t *q);
+//	void name_destroy(name_t *q);
+//	int name_add(name_t *q, type val);
+//	int name_get(name_t *q, type *val);
+//	void name_print_stats(name_t *q);
+//
+// Everything is static inline. The items live in an array of capacity
+// slots inside name_t, so adds and gets do not allocate. policy is one of
+//
+//	SPIN	test-and-test-and-set spinlock, yields after QDEF_SPINS polls
+//	FUTEX	three state futex lock, as in 2.4/mutex
+//	MUTEX	pthread_mutex_t, as in 2.2e
+//	COND	pthread_mutex_t and two condvars, as in 2.2f
+//
+// With COND add and get block while the queue is full or empty; with the
+// others they return 0, like the 2.2a/e and 2.4 queues. The policy picks
+// a family of QLOCK_<policy>_* macros below by token pasting, so there is
+// no function pointer or runtime switch left in the generated code.
+
+#define QDEF_SPINS 100
+
+static inline void qdef_cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#else
+	__asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+static inline void qdef_spin_lock(int *lock) {
+	int spins = 0;
+
+	while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE)) {
+		while (__atomic_load_n(lock, __ATOMIC_RELAXED)) {
+			if (++spins < QDEF_SPINS)
+				qdef_cpu_relax();
+			else
+				sched_yield();
+		}
+	}
+}
+
+static inline void qdef_spin_unlock(int *lock) {
+	__atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+// 0 unlocked, 1 locked, 2 locked and somebody may sleep on it
+static inline void qdef_futex_lock(uint32_t *lock) {
+	uint32_t c = 0;
+
+	if (__atomic_compare_exchange_n(lock, &c, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return;
+
+	if (c != 2)
+		c = __atomic_exchange_n(lock, 2, __ATOMIC_ACQUIRE);
+
+	while (c) {
+		syscall(SYS_futex, lock, FUTEX_WAIT_PRIVATE, 2, NULL, NULL, 0);
+		c = __atomic_exchange_n(lock, 2, __ATOMIC_ACQUIRE);
+	}
+}
+
+static inline void qdef_futex_unlock(uint32_t *lock) {
+	if (__atomic_exchange_n(lock, 0, __ATOMIC_RELEASE) == 2)
+		syscall(SYS_futex, lock, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+} qdef_cond_t;
+
+static inline void qdef_cond_init(qdef_cond_t *c) {
+	int err;
+
+	err = pthread_mutex_init(&c->lock, NULL);
+	if (!err)
+		err = pthread_cond_init(&c->not_empty, NULL);
+	if (!err)
+		err = pthread_cond_init(&c->not_full, NULL);
+
+	if (err) {
+		printf("queue_init: pthread init failed: %s\n", strerror(err));
+		abort();
+	}
+}
+
+static inline void qdef_cond_destroy(qdef_cond_t *c) {
+	pthread_cond_destroy(&c->not_full);
+	pthread_cond_destroy(&c->not_empty);
+	pthread_mutex_destroy(&c->lock);
+}
+
+static inline void qdef_mutex_init(pthread_mutex_t *m) {
+	int err = pthread_mutex_init(m, NULL);
+
+	if (err) {
+		printf("queue_init: pthread_mutex_init failed: %s\n", strerror(err));
+		abort();
+	}
+}
+
+// A policy is a type, init/destroy, lock/unlock, and the waits and
+// notifications of a blocking queue. Non-blocking policies never wait,
+// their WAIT and NOTIFY macros are only there to keep the expansion valid
+// and fold away.
+
+#define QLOCK_SPIN_T			int
+#define QLOCK_SPIN_BLOCKING		0
+#define QLOCK_SPIN_INIT(l)		(*(l) = 0)
+#define QLOCK_SPIN_DESTROY(l)		((void)(l))
+#define QLOCK_SPIN_LOCK(l)		qdef_spin_lock(l)
+#define QLOCK_SPIN_UNLOCK(l)		qdef_spin_unlock(l)
+#define QLOCK_SPIN_WAIT_NOT_FULL(l)	((void)(l))
+#define QLOCK_SPIN_WAIT_NOT_EMPTY(l)	((void)(l))
+#define QLOCK_SPIN_NOTIFY_NOT_FULL(l)	((void)(l))
+#define QLOCK_SPIN_NOTIFY_NOT_EMPTY(l)	((void)(l))
+
+#define QLOCK_FUTEX_T			uint32_t
+#define QLOCK_FUTEX_BLOCKING		0
+#define QLOCK_FUTEX_INIT(l)		(*(l) = 0)
+#define QLOCK_FUTEX_DESTROY(l)		((void)(l))
+#define QLOCK_FUTEX_LOCK(l)		qdef_futex_lock(l)
+#define QLOCK_FUTEX_UNLOCK(l)		qdef_futex_unlock(l)
+#define QLOCK_FUTEX_WAIT_NOT_FULL(l)	((void)(l))
+#define QLOCK_FUTEX_WAIT_NOT_EMPTY(l)	((void)(l))
+#define QLOCK_FUTEX_NOTIFY_NOT_FULL(l)	((void)(l))
+#define QLOCK_FUTEX_NOTIFY_NOT_EMPTY(l)	((void)(l))
+
+#define QLOCK_MUTEX_T			pthread_mutex_t
+#define QLOCK_MUTEX_BLOCKING		0
+#define QLOCK_MUTEX_INIT(l)		qdef_mutex_init(l)
+#define QLOCK_MUTEX_DESTROY(l)		pthread_mutex_destroy(l)
+#define QLOCK_MUTEX_LOCK(l)		pthread_mutex_lock(l)
+#define QLOCK_MUTEX_UNLOCK(l)		pthread_mutex_unlock(l)
+#define QLOCK_MUTEX_WAIT_NOT_FULL(l)	((void)(l))
+#define QLOCK_MUTEX_WAIT_NOT_EMPTY(l)	((void)(l))
+#define QLOCK_MUTEX_NOTIFY_NOT_FULL(l)	((void)(l))
+#define QLOCK_MUTEX_NOTIFY_NOT_EMPTY(l)	((void)(l))
+
+#define QLOCK_COND_T			qdef_cond_t
+#define QLOCK_COND_BLOCKING		1
+#define QLOCK_COND_INIT(l)		qdef_cond_init(l)
+#define QLOCK_COND_DESTROY(l)		qdef_cond_destroy(l)
+#define QLOCK_COND_LOCK(l)		pthread_mutex_lock(&(l)->lock)
+#define QLOCK_COND_UNLOCK(l)		pthread_mutex_unlock(&(l)->lock)
+#define QLOCK_COND_WAIT_NOT_FULL(l)	pthread_cond_wait(&(l)->not_full, &(l)->lock)
+#define QLOCK_COND_WAIT_NOT_EMPTY(l)	pthread_cond_wait(&(l)->not_empty, &(l)->lock)
+#define QLOCK_COND_NOTIFY_NOT_FULL(l)	pthread_cond_signal(&(l)->not_full)
+#define QLOCK_COND_NOTIFY_NOT_EMPTY(l)	pthread_cond_signal(&(l)->not_empty)
+
+// QLOCK(policy, op) names one member of a policy family. The second level
+// lets policy be a macro itself, e.g. QLOCK(QUEUE_LOCK, BLOCKING).
+#define QLOCK(policy, op) QLOCK_PASTE(policy, op)
+#define QLOCK_PASTE(policy, op) QLOCK_##policy##_##op
+
+#define QUEUE_DEFINE(name, type, capacity, policy)				\
+										\
+typedef struct {								\
+	QLOCK(policy, T) lock;							\
+	int head;								\
+	int tail;								\
+	int count;								\
+										\
+	long add_attempts;							\
+	long get_attempts;							\
+	long add_count;								\
+	long get_count;								\
+										\
+	type buf[capacity];							\
+} name##_t;									\
+										\
+static inline void name##_init(name##_t *q) {					\
+	QLOCK(policy, INIT)(&q->lock);						\
+	q->head = q->tail = q->count = 0;					\
+	q->add_attempts = q->get_attempts = 0;					\
+	q->add_count = q->get_count = 0;					\
+}										\
+										\
+static inline void name##_destroy(name##_t *q) {				\
+	QLOCK(policy, DESTROY)(&q->lock);					\
+}										\
+										\
+static inline int name##_add(name##_t *q, type val) {				\
+	QLOCK(policy, LOCK)(&q->lock);						\
+	q->add_attempts++;							\
+										\
+	while (q->count == (capacity)) {					\
+		if (!QLOCK(policy, BLOCKING)) {					\
+			QLOCK(policy, UNLOCK)(&q->lock);			\
+			return 0;						\
+		}								\
+		QLOCK(policy, WAIT_NOT_FULL)(&q->lock);				\
+	}									\
+										\
+	q->buf[q->tail] = val;							\
+	if (++q->tail == (capacity))						\
+		q->tail = 0;							\
+	q->count++;								\
+	q->add_count++;								\
+										\
+	QLOCK(policy, UNLOCK)(&q->lock);					\
+	QLOCK(policy, NOTIFY_NOT_EMPTY)(&q->lock);				\
+	return 1;								\
+}										\
+										\
+static inline int name##_get(name##_t *q, type *val) {				\
+	QLOCK(policy, LOCK)(&q->lock);						\
+	q->get_attempts++;							\
+										\
+	while (q->count == 0) {							\
+		if (!QLOCK(policy, BLOCKING)) {					\
+			QLOCK(policy, UNLOCK)(&q->lock);			\
+			return 0;						\
+		}								\
+		QLOCK(policy, WAIT_NOT_EMPTY)(&q->lock);			\
+	}									\
+										\
+	*val = q->buf[q->head];							\
+	if (++q->head == (capacity))						\
+		q->head = 0;							\
+	q->count--;								\
+	q->get_count++;								\
+										\
+	QLOCK(policy, UNLOCK)(&q->lock);					\
+	QLOCK(policy, NOTIFY_NOT_FULL)(&q->lock);				\
+	return 1;								\
+}										\
+										\
+static inline void name##_print_stats(name##_t *q) {				\
+	printf("queue stats: current size %d; attempts: (%ld %ld %ld); counts (%ld %ld %ld)\n", \
+		q->count,							\
+		q->add_attempts, q->get_attempts, q->add_attempts - q->get_attempts, \
+		q->add_count, q->get_count, q->add_count - q->get_count);	\
+}
+
+#endif		// __FITOS_QDEFINE_H__
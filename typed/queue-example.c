@@ -0,0 +1,67 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include "queue.h"
+
+// A queue of something that is not an int, with its own lock policy.
+typedef struct {
+	int id;
+	double value;
+} msg_t;
+
+QUEUE_DEFINE(msgq, msg_t, 4, SPIN)
+
+int main() {
+	// a blocking queue would wait forever for the last two gets
+	int gets = QLOCK(QUEUE_LOCK, BLOCKING) ? 10 : 12;
+	queue_t *q;
+	msgq_t mq;
+	msg_t m;
+
+	printf("main: [%d %d %d]\n", getpid(), getppid(), gettid());
+
+	q = queue_init(QUEUE_CAPACITY);
+
+	for (int i = 0; i < 10; i++) {
+		int ok = queue_add(q, i);
+
+		printf("ok %d: add value %d\n", ok, i);
+
+		queue_print_stats(q);
+	}
+
+	for (int i = 0; i < gets; i++) {
+		int val = -1;
+		int ok = queue_get(q, &val);
+
+		printf("ok: %d: get value %d\n", ok, val);
+
+		queue_print_stats(q);
+	}
+
+	queue_destroy(q);
+
+	msgq_init(&mq);
+
+	for (int i = 0; i < 6; i++) {
+		m.id = i;
+		m.value = i / 2.0;
+
+		printf("ok %d: add msg %d\n", msgq_add(&mq, m), i);
+	}
+
+	while (msgq_get(&mq, &m))
+		printf("get msg %d %.1f\n", m.id, m.value);
+
+	msgq_print_stats(&mq);
+	msgq_destroy(&mq);
+
+	return 0;
+}
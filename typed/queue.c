@@ -0,0 +1,39 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+
+#include "queue.h"
+
+#define STR(x) #x
+#define XSTR(x) STR(x)
+
+queue_t* queue_init(int max_count) {
+	queue_t *q;
+
+	if (max_count != QUEUE_CAPACITY) {
+		printf("queue_init: built for %d items, rebuild with -DQUEUE_CAPACITY=%d\n",
+			QUEUE_CAPACITY, max_count);
+		abort();
+	}
+
+	q = malloc(sizeof(queue_t));
+	if (!q) {
+		printf("Cannot allocate memory for a queue\n");
+		abort();
+	}
+
+	iqueue_init(&q->q);
+
+	return q;
+}
+
+void queue_destroy(queue_t *q) {
+	if (q == NULL) return;
+
+	iqueue_destroy(&q->q);
+	free(q);
+}
+
+void queue_print_stats(queue_t *q) {
+	printf("%s ", XSTR(QUEUE_LOCK));
+	iqueue_print_stats(&q->q);
+}
@@ -0,0 +1,47 @@
+#ifndef __FITOS_QUEUE_H__
+#define __FITOS_QUEUE_H__
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "qdefine.h"
+
+// The usual int queue API on top of QUEUE_DEFINE, so the generated code
+// can be run by the examples and ../bench next to the hand-written queues.
+// Capacity and lock are fixed when compiling: -DQUEUE_CAPACITY=n and
+// -DQUEUE_LOCK=SPIN|FUTEX|MUTEX|COND.
+
+#ifndef QUEUE_CAPACITY
+#define QUEUE_CAPACITY 1000
+#endif
+
+#ifndef QUEUE_LOCK
+#define QUEUE_LOCK MUTEX
+#endif
+
+QUEUE_DEFINE(iqueue, int, QUEUE_CAPACITY, QUEUE_LOCK)
+
+typedef struct _Queue {
+	iqueue_t q;
+} queue_t;
+
+// max_count must be QUEUE_CAPACITY
+queue_t* queue_init(int max_count);
+void queue_destroy(queue_t *q);
+void queue_print_stats(queue_t *q);
+
+static inline int queue_add(queue_t *q, int val) {
+	return iqueue_add(&q->q, val);
+}
+
+static inline int queue_get(queue_t *q, int *val) {
+	return iqueue_get(&q->q, val);
+}
+
+#endif		// __FITOS_QUEUE_H__